@@ -2,14 +2,22 @@
 
 #include <napi-macros.h>
 #include <node_api.h>
+#include <uv.h>
 #include <assert.h>
 
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 #include <leveldb/cache.h>
 #include <leveldb/filter_policy.h>
+#include <leveldb/prefix_extractor.h>
+#include <leveldb/write_buffer_manager.h>
+#include <db/write_batch_internal.h>
 
+#include <atomic>
+#include <cmath>
+#include <deque>
 #include <map>
+#include <utility>
 #include <vector>
 
 /**
@@ -18,6 +26,7 @@
 struct Database;
 struct Iterator;
 struct EndWorker;
+struct WriteGroupWorker;
 static void iterator_end_do (napi_env env, Iterator* iterator, napi_value cb);
 
 /**
@@ -156,6 +165,25 @@ static uint32_t Uint32Property (napi_env env, napi_value obj, const char* key,
   return DEFAULT;
 }
 
+/**
+ * Returns the data of an external property 'key' from 'obj'.
+ * Returns NULL if the property doesn't exist or isn't an external.
+ */
+static void* ExternalProperty (napi_env env, napi_value obj, const char* key) {
+  if (HasProperty(env, obj, key)) {
+    napi_value value = GetProperty(env, obj, key);
+    napi_valuetype type;
+    void* result = NULL;
+    napi_typeof(env, value, &type);
+    if (type == napi_external) {
+      napi_get_value_external(env, value, &result);
+    }
+    return result;
+  }
+
+  return NULL;
+}
+
 /**
  * Returns a uint32 property 'key' from 'obj'.
  * Returns 'DEFAULT' if the property doesn't exist.
@@ -172,6 +200,22 @@ static int Int32Property (napi_env env, napi_value obj, const char* key,
   return DEFAULT;
 }
 
+/**
+ * Returns a double property 'key' from 'obj'.
+ * Returns 'DEFAULT' if the property doesn't exist or isn't a finite number.
+ */
+static double DoubleProperty (napi_env env, napi_value obj, const char* key,
+                              double DEFAULT) {
+  if (HasProperty(env, obj, key)) {
+    napi_value value = GetProperty(env, obj, key);
+    double result = DEFAULT;
+    napi_get_value_double(env, value, &result);
+    return std::isfinite(result) ? result : DEFAULT;
+  }
+
+  return DEFAULT;
+}
+
 /**
  * Returns a string property 'key' from 'obj'.
  * Returns empty string if the property doesn't exist.
@@ -196,6 +240,23 @@ static std::string StringProperty (napi_env env, napi_value obj, const char* key
   return "";
 }
 
+/**
+ * Creates a block cache of 'size' bytes with the eviction policy 'policy',
+ * split into 'shards' shards (rounded up to a power of two).
+ */
+static leveldb::Cache* NewBlockCache (uint32_t size, const std::string& policy,
+                                      uint32_t shards) {
+  int shardBits = 0;
+  while (shardBits < 31 && (1u << shardBits) < shards) {
+    shardBits++;
+  }
+
+  if (policy == "segmented") {
+    return leveldb::NewSegmentedLRUCache(size, shardBits);
+  }
+  return leveldb::NewLRUCache(size, shardBits);
+}
+
 static void DisposeSliceBuffer (leveldb::Slice slice) {
   if (!slice.empty()) delete [] slice.data();
 }
@@ -208,6 +269,62 @@ static leveldb::Slice ToSlice (napi_env env, napi_value from) {
   return leveldb::Slice(toCh_, toSz_);
 }
 
+/**
+ * Like ToSlice() but references the memory of a buffer instead of copying it.
+ * For buffers 'ref' is set to a reference that keeps the buffer alive until
+ * DisposeSliceOrRef() is called. Otherwise 'ref' is set to NULL and the slice
+ * owns a copy, like ToSlice().
+ */
+static leveldb::Slice ToSliceOrRef (napi_env env, napi_value from, napi_ref* ref) {
+  *ref = NULL;
+
+  if (IsBuffer(env, from)) {
+    char* buf = 0;
+    size_t size = 0;
+    napi_get_buffer_info(env, from, (void **)&buf, &size);
+    if (size == 0) return leveldb::Slice();
+    napi_create_reference(env, from, 1, ref);
+    return leveldb::Slice(buf, size);
+  }
+
+  return ToSlice(env, from);
+}
+
+/**
+ * Releases a slice obtained from ToSliceOrRef().
+ */
+static void DisposeSliceOrRef (napi_env env, leveldb::Slice slice, napi_ref ref) {
+  if (ref != NULL) {
+    napi_delete_reference(env, ref);
+  } else {
+    DisposeSliceBuffer(slice);
+  }
+}
+
+/**
+ * Returns a slice of a string or buffer that is only valid until 'scratch'
+ * is reused or control returns to JS. Buffers are not copied, strings are
+ * decoded into 'scratch' so that its capacity is reused between calls.
+ */
+static leveldb::Slice ToTransientSlice (napi_env env, napi_value from,
+                                        std::string& scratch) {
+  size_t size = 0;
+
+  if (IsString(env, from)) {
+    napi_get_value_string_utf8(env, from, NULL, 0, &size);
+    scratch.resize(size + 1);
+    napi_get_value_string_utf8(env, from, &scratch[0], size + 1, &size);
+    scratch.resize(size);
+    return leveldb::Slice(scratch);
+  } else if (IsBuffer(env, from)) {
+    char* buf = 0;
+    napi_get_buffer_info(env, from, (void **)&buf, &size);
+    if (size > 0) return leveldb::Slice(buf, size);
+  }
+
+  return leveldb::Slice();
+}
+
 /**
  * Returns length of string or buffer
  */
@@ -224,6 +341,43 @@ static size_t StringOrBufferLength (napi_env env, napi_value value) {
   return size;
 }
 
+/**
+ * Values at least this large are handed to JS as external buffers.
+ */
+static const size_t kExternalBufferThreshold = 4096;
+
+/**
+ * Runs when an external buffer created by NewBuffer() is garbage collected.
+ */
+static void FinalizeExternalString (napi_env env, void* data, void* hint) {
+  delete (std::string*)hint;
+}
+
+/**
+ * Creates a Buffer holding the contents of 'value'. Large values are moved
+ * into an external buffer so that they reach JS without another copy. Small
+ * values are copied, which is cheaper than finalizing an external buffer.
+ * Leaves 'value' empty or unchanged.
+ */
+static napi_status NewBuffer (napi_env env, std::string& value, napi_value* result) {
+  if (value.size() >= kExternalBufferThreshold) {
+    std::string* owned = new std::string();
+    owned->swap(value);
+
+    napi_status status = napi_create_external_buffer(env, owned->size(),
+                                                     &(*owned)[0],
+                                                     FinalizeExternalString,
+                                                     owned, result);
+    if (status == napi_ok) return status;
+
+    // External buffers may be disallowed (e.g. in Electron), fall back to a copy.
+    owned->swap(value);
+    delete owned;
+  }
+
+  return napi_create_buffer_copy(env, value.size(), value.data(), NULL, result);
+}
+
 /**
  * Calls a function.
  */
@@ -236,10 +390,21 @@ static napi_status CallFunction (napi_env env,
   return napi_call_function(env, global, callback, argc, argv, NULL);
 }
 
+/**
+ * Which queue of a database's WorkerPool a worker runs on.
+ */
+enum WorkerKind {
+  kOtherWork,
+  kReadWork,
+  kWriteWork
+};
+
 /**
  * Base worker class. Handles the async work. Derived classes can override the
  * following virtual methods (listed in the order in which they're called):
  *
+ * - Kind (main thread): run on the read or write queue of a WorkerPool,
+ *   if the database has one, rather than on the libuv threadpool
  * - DoExecute (abstract, worker pool thread): main work
  * - HandleOKCallback (main thread): call JS callback on success
  * - DoFinally (main thread): do cleanup regardless of success
@@ -287,6 +452,7 @@ struct BaseWorker {
     memcpy(errMsg_, msg, size);
   }
 
+  virtual WorkerKind Kind () { return kOtherWork; }
   virtual void DoExecute () = 0;
   virtual void DoFinally () {};
 
@@ -316,9 +482,7 @@ struct BaseWorker {
     CallFunction(env_, callback, 1, &argv);
   }
 
-  void Queue () {
-    napi_queue_async_work(env_, asyncWork_);
-  }
+  void Queue ();
 
   napi_env env_;
   napi_ref callbackRef_;
@@ -331,22 +495,472 @@ private:
 };
 
 /**
- * Owns the LevelDB storage, cache, filter policy and iterators.
+ * Threads owned by a database, with separate queues for reads and writes, so
+ * that slow work doesn't hold up other users of the libuv threadpool or the
+ * other kind of work. Completed workers are handed back to the main thread
+ * through a uv_async_t.
+ */
+struct WorkerPool {
+  struct WorkQueue {
+    std::deque<BaseWorker*> jobs_;
+    std::vector<uv_thread_t> threads_;
+    uv_cond_t cond_;
+  };
+
+  struct Thread {
+    WorkerPool* pool_;
+    WorkQueue* queue_;
+  };
+
+  WorkerPool (napi_env env, uint32_t readThreads, uint32_t writeThreads)
+    : env_(env), stopping_(false), pending_(0) {
+    uv_mutex_init(&mutex_);
+    uv_cond_init(&reads_.cond_);
+    uv_cond_init(&writes_.cond_);
+
+    uv_loop_t* loop;
+    napi_get_uv_event_loop(env_, &loop);
+    async_ = new uv_async_t;
+    async_->data = this;
+    uv_async_init(loop, async_, WorkerPool::OnComplete);
+    // Only keep the event loop alive while there is work in flight.
+    uv_unref((uv_handle_t*)async_);
+
+    napi_value resource;
+    napi_value resourceName;
+    napi_create_object(env_, &resource);
+    napi_create_reference(env_, resource, 1, &resourceRef_);
+    napi_create_string_utf8(env_, "leveldown.pool", NAPI_AUTO_LENGTH,
+                            &resourceName);
+    napi_async_init(env_, resource, resourceName, &asyncContext_);
+
+    Start(&reads_, readThreads);
+    Start(&writes_, writeThreads);
+  }
+
+  /**
+   * Only releases resources, so that it's safe in a GC finalizer. Call
+   * Shutdown() first to complete the work that is in flight.
+   */
+  ~WorkerPool () {
+    Stop(&reads_);
+    Stop(&writes_);
+
+    uv_close((uv_handle_t*)async_, WorkerPool::OnClose);
+    napi_async_destroy(env_, asyncContext_);
+    napi_delete_reference(env_, resourceRef_);
+    uv_cond_destroy(&reads_.cond_);
+    uv_cond_destroy(&writes_.cond_);
+    uv_mutex_destroy(&mutex_);
+  }
+
+  /**
+   * Stops the threads and completes what they finished since the last
+   * OnComplete(). Must be called on the main thread, outside of GC
+   * finalizers, because completing workers calls into JS.
+   */
+  void Shutdown () {
+    Stop(&reads_);
+    Stop(&writes_);
+    Drain();
+  }
+
+  /**
+   * Queues a worker. Returns false if there's no thread for its kind of work.
+   */
+  bool Push (BaseWorker* worker) {
+    WorkerKind kind = worker->Kind();
+    WorkQueue* queue = kind == kReadWork ? &reads_
+      : kind == kWriteWork ? &writes_
+      : NULL;
+
+    if (queue == NULL || queue->threads_.empty()) return false;
+    if (pending_++ == 0) uv_ref((uv_handle_t*)async_);
+
+    uv_mutex_lock(&mutex_);
+    queue->jobs_.push_back(worker);
+    uv_cond_signal(&queue->cond_);
+    uv_mutex_unlock(&mutex_);
+
+    return true;
+  }
+
+  void Start (WorkQueue* queue, uint32_t size) {
+    for (uint32_t i = 0; i < size; i++) {
+      Thread* thread = new Thread;
+      thread->pool_ = this;
+      thread->queue_ = queue;
+
+      uv_thread_t tid;
+      if (uv_thread_create(&tid, WorkerPool::Run, thread) != 0) {
+        delete thread;
+        break;
+      }
+
+      queue->threads_.push_back(tid);
+    }
+  }
+
+  void Stop (WorkQueue* queue) {
+    uv_mutex_lock(&mutex_);
+    stopping_ = true;
+    uv_cond_broadcast(&queue->cond_);
+    uv_mutex_unlock(&mutex_);
+
+    for (size_t i = 0; i < queue->threads_.size(); i++) {
+      uv_thread_join(&queue->threads_[i]);
+    }
+
+    queue->threads_.clear();
+  }
+
+  /**
+   * Thread entry point. Runs queued workers until the pool is stopped and
+   * the queue is empty.
+   */
+  static void Run (void* arg) {
+    Thread* thread = (Thread*)arg;
+    WorkerPool* pool = thread->pool_;
+    WorkQueue* queue = thread->queue_;
+    delete thread;
+
+    uv_mutex_lock(&pool->mutex_);
+
+    while (true) {
+      while (queue->jobs_.empty() && !pool->stopping_) {
+        uv_cond_wait(&queue->cond_, &pool->mutex_);
+      }
+
+      if (queue->jobs_.empty()) break;
+
+      BaseWorker* worker = queue->jobs_.front();
+      queue->jobs_.pop_front();
+      uv_mutex_unlock(&pool->mutex_);
+
+      BaseWorker::Execute(pool->env_, worker);
+
+      uv_mutex_lock(&pool->mutex_);
+      pool->completed_.push_back(worker);
+      uv_async_send(pool->async_);
+    }
+
+    uv_mutex_unlock(&pool->mutex_);
+  }
+
+  /**
+   * Completes workers on the main thread.
+   */
+  void Drain () {
+    std::vector<BaseWorker*> completed;
+
+    uv_mutex_lock(&mutex_);
+    completed.swap(completed_);
+    uv_mutex_unlock(&mutex_);
+
+    if (completed.empty()) return;
+
+    pending_ -= completed.size();
+    if (pending_ == 0) uv_unref((uv_handle_t*)async_);
+
+    napi_handle_scope handleScope;
+    napi_callback_scope callbackScope;
+    napi_value resource;
+    napi_open_handle_scope(env_, &handleScope);
+    napi_get_reference_value(env_, resourceRef_, &resource);
+    napi_open_callback_scope(env_, resource, asyncContext_, &callbackScope);
+
+    for (size_t i = 0; i < completed.size(); i++) {
+      BaseWorker::Complete(env_, napi_ok, completed[i]);
+
+      bool pending = false;
+      napi_is_exception_pending(env_, &pending);
+      if (pending) {
+        napi_value error;
+        napi_get_and_clear_last_exception(env_, &error);
+        napi_fatal_exception(env_, error);
+      }
+    }
+
+    napi_close_callback_scope(env_, callbackScope);
+    napi_close_handle_scope(env_, handleScope);
+  }
+
+  static void OnComplete (uv_async_t* handle) {
+    ((WorkerPool*)handle->data)->Drain();
+  }
+
+  static void OnClose (uv_handle_t* handle) {
+    delete (uv_async_t*)handle;
+  }
+
+  napi_env env_;
+  uv_mutex_t mutex_;
+  WorkQueue reads_;
+  WorkQueue writes_;
+  std::vector<BaseWorker*> completed_;
+  bool stopping_;
+  size_t pending_;
+  uv_async_t* async_;
+  napi_ref resourceRef_;
+  napi_async_context asyncContext_;
+};
+
+/**
+ * Tracks whether LevelDB delays or stops writes. LevelDB reports changes from
+ * the writing thread, which are handed to the main thread through a
+ * uv_async_t and passed to the listener set with db_set_write_stall_listener.
+ * Changes that happen in quick succession are coalesced into the latest one.
+ */
+struct WriteStallMonitor final : public leveldb::WriteStallListener {
+  WriteStallMonitor (napi_env env)
+    : env_(env),
+      condition_(leveldb::kWriteStallNormal),
+      cause_(leveldb::kWriteStallNoCause),
+      notifiedCondition_(leveldb::kWriteStallNormal),
+      notifiedCause_(leveldb::kWriteStallNoCause),
+      listenerRef_(NULL) {
+    uv_mutex_init(&mutex_);
+
+    uv_loop_t* loop;
+    napi_get_uv_event_loop(env_, &loop);
+    async_ = new uv_async_t;
+    async_->data = this;
+    uv_async_init(loop, async_, WriteStallMonitor::OnChange);
+    // Don't keep the event loop alive for stall notifications.
+    uv_unref((uv_handle_t*)async_);
+
+    napi_value resource;
+    napi_value resourceName;
+    napi_create_object(env_, &resource);
+    napi_create_reference(env_, resource, 1, &resourceRef_);
+    napi_create_string_utf8(env_, "leveldown.write_stall", NAPI_AUTO_LENGTH,
+                            &resourceName);
+    napi_async_init(env_, resource, resourceName, &asyncContext_);
+  }
+
+  /**
+   * Must be called on the main thread, after the database is closed.
+   */
+  ~WriteStallMonitor () {
+    SetListener(NULL);
+    uv_close((uv_handle_t*)async_, WriteStallMonitor::OnClose);
+    napi_async_destroy(env_, asyncContext_);
+    napi_delete_reference(env_, resourceRef_);
+    uv_mutex_destroy(&mutex_);
+  }
+
+  void OnWriteStallChange (leveldb::WriteStallCondition condition,
+                           leveldb::WriteStallCause cause) override {
+    uv_mutex_lock(&mutex_);
+    condition_ = condition;
+    cause_ = cause;
+    uv_mutex_unlock(&mutex_);
+    uv_async_send(async_);
+  }
+
+  /**
+   * Returns to the normal state, since a database that is opened again does
+   * not inherit the stall of its previous instance.
+   */
+  void Reset () {
+    OnWriteStallChange(leveldb::kWriteStallNormal, leveldb::kWriteStallNoCause);
+  }
+
+  napi_value State (napi_env env) {
+    uv_mutex_lock(&mutex_);
+    leveldb::WriteStallCondition condition = condition_;
+    leveldb::WriteStallCause cause = cause_;
+    uv_mutex_unlock(&mutex_);
+
+    return StateObject(env, condition, cause);
+  }
+
+  void SetListener (napi_value listener) {
+    if (listenerRef_ != NULL) {
+      napi_delete_reference(env_, listenerRef_);
+      listenerRef_ = NULL;
+    }
+    if (listener != NULL) {
+      napi_create_reference(env_, listener, 1, &listenerRef_);
+    }
+  }
+
+  static napi_value StateObject (napi_env env,
+                                 leveldb::WriteStallCondition condition,
+                                 leveldb::WriteStallCause cause) {
+    const char* conditionName =
+      condition == leveldb::kWriteStallDelayed ? "delayed"
+      : condition == leveldb::kWriteStallStopped ? "stopped"
+      : "normal";
+    const char* causeName =
+      cause == leveldb::kWriteStallLevel0Files ? "level0Files"
+      : cause == leveldb::kWriteStallMemTables ? "memtables"
+      : NULL;
+
+    napi_value state;
+    napi_value value;
+    napi_create_object(env, &state);
+    napi_create_string_utf8(env, conditionName, NAPI_AUTO_LENGTH, &value);
+    napi_set_named_property(env, state, "condition", value);
+    if (causeName != NULL) {
+      napi_create_string_utf8(env, causeName, NAPI_AUTO_LENGTH, &value);
+    } else {
+      napi_get_null(env, &value);
+    }
+    napi_set_named_property(env, state, "cause", value);
+
+    return state;
+  }
+
+  /**
+   * Calls the listener on the main thread, if the state changed since the
+   * last call.
+   */
+  void Notify () {
+    uv_mutex_lock(&mutex_);
+    leveldb::WriteStallCondition condition = condition_;
+    leveldb::WriteStallCause cause = cause_;
+    uv_mutex_unlock(&mutex_);
+
+    if (condition == notifiedCondition_ && cause == notifiedCause_) return;
+    notifiedCondition_ = condition;
+    notifiedCause_ = cause;
+
+    if (listenerRef_ == NULL) return;
+
+    napi_handle_scope handleScope;
+    napi_open_handle_scope(env_, &handleScope);
+
+    napi_value resource;
+    napi_value listener;
+    napi_value argv;
+    napi_value result;
+    napi_get_reference_value(env_, resourceRef_, &resource);
+    napi_get_reference_value(env_, listenerRef_, &listener);
+    argv = StateObject(env_, condition, cause);
+    napi_make_callback(env_, asyncContext_, resource, listener, 1, &argv,
+                       &result);
+
+    bool pending = false;
+    napi_is_exception_pending(env_, &pending);
+    if (pending) {
+      napi_value error;
+      napi_get_and_clear_last_exception(env_, &error);
+      napi_fatal_exception(env_, error);
+    }
+
+    napi_close_handle_scope(env_, handleScope);
+  }
+
+  static void OnChange (uv_async_t* handle) {
+    ((WriteStallMonitor*)handle->data)->Notify();
+  }
+
+  static void OnClose (uv_handle_t* handle) {
+    delete (uv_async_t*)handle;
+  }
+
+  napi_env env_;
+  uv_mutex_t mutex_;
+  leveldb::WriteStallCondition condition_;
+  leveldb::WriteStallCause cause_;
+  // Last state passed to the listener, only used on the main thread.
+  leveldb::WriteStallCondition notifiedCondition_;
+  leveldb::WriteStallCause notifiedCause_;
+  napi_ref listenerRef_;
+  uv_async_t* async_;
+  napi_ref resourceRef_;
+  napi_async_context asyncContext_;
+};
+
+/**
+ * A LevelDB object that is shared by several databases. It is referenced by
+ * its JavaScript context and by every open database that uses it, and is
+ * deleted when the last reference is released. Databases release theirs on
+ * the thread that closes them.
+ */
+template <typename T>
+struct Shared {
+  explicit Shared (T* object) : object_(object), refs_(1) {}
+
+  void Ref () {
+    ++refs_;
+  }
+
+  void Unref () {
+    if (--refs_ == 0) {
+      delete object_;
+      delete this;
+    }
+  }
+
+  T* object_;
+
+private:
+  ~Shared () {}
+
+  std::atomic<uint32_t> refs_;
+};
+
+typedef Shared<leveldb::Cache> SharedCache;
+typedef Shared<leveldb::WriteBufferManager> SharedWriteBufferManager;
+
+/**
+ * Runs when the context of a shared object is garbage collected.
+ */
+template <typename T>
+static void FinalizeShared (napi_env env, void* data, void* hint) {
+  if (data) {
+    ((Shared<T>*)data)->Unref();
+  }
+}
+
+/**
+ * Owns the LevelDB storage, cache, filter policy, prefix extractor and
+ * iterators.
  */
 struct Database {
   Database (napi_env env)
     : env_(env),
       db_(NULL),
       blockCache_(NULL),
-      filterPolicy_(leveldb::NewBloomFilterPolicy(10)),
+      sharedCache_(NULL),
+      writeBufferManager_(NULL),
+      filterPolicy_(NULL),
+      prefixExtractor_(NULL),
+      pool_(NULL),
+      stallMonitor_(new WriteStallMonitor(env)),
+      coalesceWrites_(false),
+      writeGroup_(NULL),
+      writeGroupInFlight_(false),
       currentIteratorId_(0),
       pendingCloseWorker_(NULL),
       priorityWork_(0) {}
 
   ~Database () {
-    if (db_ != NULL) {
-      delete db_;
-      db_ = NULL;
+    // The close path has completed the work of the pool; only free it here.
+    delete pool_;
+    CloseDatabase();
+    if (filterPolicy_ != NULL) {
+      delete filterPolicy_;
+      filterPolicy_ = NULL;
+    }
+    if (prefixExtractor_ != NULL) {
+      delete prefixExtractor_;
+      prefixExtractor_ = NULL;
+    }
+    delete stallMonitor_;
+  }
+
+  /**
+   * Must be called on the main thread, with no work queued on the pool.
+   * Completes the work that the pool finished, so it calls into JS.
+   */
+  void DestroyPool () {
+    if (pool_ != NULL) {
+      pool_->Shutdown();
+      delete pool_;
+      pool_ = NULL;
     }
   }
 
@@ -355,12 +969,22 @@ struct Database {
     return leveldb::DB::Open(options, location, &db_);
   }
 
+  /**
+   * Also releases the cache and write buffer manager of a failed open.
+   */
   void CloseDatabase () {
     delete db_;
     db_ = NULL;
-    if (blockCache_) {
+    if (sharedCache_ != NULL) {
+      sharedCache_->Unref();
+      sharedCache_ = NULL;
+    } else if (blockCache_ != NULL) {
       delete blockCache_;
-      blockCache_ = NULL;
+    }
+    blockCache_ = NULL;
+    if (writeBufferManager_ != NULL) {
+      writeBufferManager_->Unref();
+      writeBufferManager_ = NULL;
     }
   }
 
@@ -441,7 +1065,17 @@ struct Database {
   napi_env env_;
   leveldb::DB* db_;
   leveldb::Cache* blockCache_;
+  // Set if blockCache_ is shared with other databases.
+  SharedCache* sharedCache_;
+  SharedWriteBufferManager* writeBufferManager_;
   const leveldb::FilterPolicy* filterPolicy_;
+  const leveldb::PrefixExtractor* prefixExtractor_;
+  WorkerPool* pool_;
+  WriteStallMonitor* stallMonitor_;
+  bool coalesceWrites_;
+  // Collects writes while another write group is in flight.
+  WriteGroupWorker* writeGroup_;
+  bool writeGroupInFlight_;
   uint32_t currentIteratorId_;
   BaseWorker *pendingCloseWorker_;
   std::map< uint32_t, Iterator * > iterators_;
@@ -450,6 +1084,18 @@ private:
   uint32_t priorityWork_;
 };
 
+/**
+ * Queues a worker on its database's pool, or on the libuv threadpool.
+ */
+void BaseWorker::Queue () {
+  if (database_ != NULL && database_->pool_ != NULL &&
+      database_->pool_->Push(this)) {
+    return;
+  }
+
+  napi_queue_async_work(env_, asyncWork_);
+}
+
 /**
  * Runs when a Database is garbage collected.
  */
@@ -494,7 +1140,10 @@ struct Iterator {
             bool fillCache,
             bool keyAsBuffer,
             bool valueAsBuffer,
-            uint32_t highWaterMark)
+            bool packed,
+            uint32_t highWaterMark,
+            uint32_t prefetch,
+            std::string* prefix)
     : database_(database),
       id_(id),
       start_(start),
@@ -509,7 +1158,10 @@ struct Iterator {
       gte_(gte),
       keyAsBuffer_(keyAsBuffer),
       valueAsBuffer_(valueAsBuffer),
+      packed_(packed),
       highWaterMark_(highWaterMark),
+      prefetch_(prefetch),
+      prefix_(prefix),
       dbIterator_(NULL),
       count_(0),
       target_(NULL),
@@ -517,11 +1169,17 @@ struct Iterator {
       landed_(false),
       nexting_(false),
       ended_(false),
+      finished_(false),
+      seekPending_(false),
       endWorker_(NULL),
+      nextCallbackRef_(NULL),
       ref_(NULL) {
     options_ = new leveldb::ReadOptions();
     options_->fill_cache = fillCache;
     options_->snapshot = database->NewSnapshot();
+    if (prefix_ != NULL) {
+      options_->prefix = *prefix_;
+    }
   }
 
   ~Iterator () {
@@ -554,6 +1212,9 @@ struct Iterator {
       delete gte_;
     }
     delete options_;
+    if (prefix_ != NULL) {
+      delete prefix_;
+    }
   }
 
   void ReleaseTarget () {
@@ -576,6 +1237,24 @@ struct Iterator {
     return ref_;
   }
 
+  napi_value Handle (napi_env env) {
+    napi_value handle;
+    napi_get_reference_value(env, ref_, &handle);
+    return handle;
+  }
+
+  void ReleaseChunks (napi_env env) {
+    while (!chunks_.empty()) {
+      napi_delete_reference(env, chunks_.front());
+      chunks_.pop_front();
+    }
+  }
+
+  bool ShouldPrefetch () {
+    return !ended_ && !nexting_ && !finished_ && !seekPending_ &&
+      chunks_.size() < prefetch_;
+  }
+
   leveldb::Status IteratorStatus () {
     return dbIterator_->status();
   }
@@ -670,6 +1349,48 @@ struct Iterator {
     return false;
   }
 
+  void Seek () {
+    GetIterator();
+    dbIterator_->Seek(*target_);
+
+    seeking_ = true;
+    landed_ = false;
+
+    if (OutOfRange(target_)) {
+      if (reverse_) {
+        dbIterator_->SeekToFirst();
+        dbIterator_->Prev();
+      } else {
+        dbIterator_->SeekToLast();
+        dbIterator_->Next();
+      }
+    }
+    else if (dbIterator_->Valid()) {
+      int cmp = dbIterator_->key().compare(*target_);
+      if (cmp > 0 && reverse_) {
+        dbIterator_->Prev();
+      } else if (cmp < 0 && !reverse_) {
+        dbIterator_->Next();
+      }
+    } else {
+      if (reverse_) {
+        dbIterator_->SeekToLast();
+      } else {
+        dbIterator_->SeekToFirst();
+      }
+      if (dbIterator_->Valid()) {
+        int cmp = dbIterator_->key().compare(*target_);
+        if (cmp > 0 && reverse_) {
+          dbIterator_->SeekToFirst();
+          dbIterator_->Prev();
+        } else if (cmp < 0 && !reverse_) {
+          dbIterator_->SeekToLast();
+          dbIterator_->Next();
+        }
+      }
+    }
+  }
+
   bool OutOfRange (leveldb::Slice* target) {
     if ((lt_ != NULL && target->compare(*lt_) >= 0) ||
         (lte_ != NULL && target->compare(*lte_) > 0) ||
@@ -694,14 +1415,14 @@ struct Iterator {
       bool ok = Read(key, value);
 
       if (ok) {
-        result.push_back(std::make_pair(key, value));
+        size = size + key.size() + value.size();
+        result.push_back(std::make_pair(std::move(key), std::move(value)));
 
         if (!landed_) {
           landed_ = true;
           return true;
         }
 
-        size = size + key.size() + value.size();
         if (size > highWaterMark_) return true;
 
       } else {
@@ -710,6 +1431,35 @@ struct Iterator {
     }
   }
 
+  /**
+   * Like IteratorNext() but appends keys and values to a single 'data' string.
+   * The key of row n is at [offsets[2n], offsets[2n + 1]) and its value at
+   * [offsets[2n + 1], offsets[2n + 2]).
+   */
+  bool IteratorNextPacked (std::string& data, std::vector<uint32_t>& offsets) {
+    std::string key, value;
+    offsets.push_back(0);
+
+    while (true) {
+      key.clear();
+      value.clear();
+
+      if (!Read(key, value)) return false;
+
+      data.append(key);
+      offsets.push_back(static_cast<uint32_t>(data.size()));
+      data.append(value);
+      offsets.push_back(static_cast<uint32_t>(data.size()));
+
+      if (!landed_) {
+        landed_ = true;
+        return true;
+      }
+
+      if (data.size() > highWaterMark_) return true;
+    }
+  }
+
   Database* database_;
   uint32_t id_;
   leveldb::Slice* start_;
@@ -724,7 +1474,11 @@ struct Iterator {
   std::string* gte_;
   bool keyAsBuffer_;
   bool valueAsBuffer_;
+  bool packed_;
   uint32_t highWaterMark_;
+  uint32_t prefetch_;
+  // Bounds the iterator to keys that start with it, if set.
+  std::string* prefix_;
   leveldb::Iterator* dbIterator_;
   int count_;
   leveldb::Slice* target_;
@@ -732,9 +1486,15 @@ struct Iterator {
   bool landed_;
   bool nexting_;
   bool ended_;
+  bool finished_;
+  bool seekPending_;
 
   leveldb::ReadOptions* options_;
   EndWorker* endWorker_;
+  // JS callback waiting for the chunk that is being read.
+  napi_ref nextCallbackRef_;
+  // Chunks read ahead of time, as arrays of callback arguments.
+  std::deque<napi_ref> chunks_;
 
 private:
   napi_ref ref_;
@@ -753,6 +1513,71 @@ NAPI_METHOD(db_init) {
   return result;
 }
 
+/**
+ * Returns a context object for a block cache of 'size' bytes that can be
+ * shared by databases.
+ */
+NAPI_METHOD(cache_init) {
+  NAPI_ARGV(2);
+  uint32_t size = 0;
+  NAPI_STATUS_THROWS(napi_get_value_uint32(env, argv[0], &size));
+  std::string policy = StringProperty(env, argv[1], "policy");
+  uint32_t shards = Uint32Property(env, argv[1], "shards", 16);
+
+  SharedCache* cache = new SharedCache(NewBlockCache(size, policy, shards));
+
+  napi_value result;
+  NAPI_STATUS_THROWS(napi_create_external(env, cache,
+                                          FinalizeShared<leveldb::Cache>,
+                                          NULL, &result));
+  return result;
+}
+
+/**
+ * Returns the total size of the blocks in a shared cache.
+ */
+NAPI_METHOD(cache_usage) {
+  NAPI_ARGV(1);
+  SharedCache* cache = NULL;
+  NAPI_STATUS_THROWS(napi_get_value_external(env, argv[0], (void**)&cache));
+
+  napi_value result;
+  napi_create_double(env, (double)cache->object_->TotalCharge(), &result);
+  return result;
+}
+
+/**
+ * Returns a context object for a budget of 'size' bytes for the write
+ * buffers of the databases that share it.
+ */
+NAPI_METHOD(write_buffer_manager_init) {
+  NAPI_ARGV(1);
+  uint32_t size = 0;
+  NAPI_STATUS_THROWS(napi_get_value_uint32(env, argv[0], &size));
+
+  SharedWriteBufferManager* manager =
+    new SharedWriteBufferManager(new leveldb::WriteBufferManager(size));
+
+  napi_value result;
+  NAPI_STATUS_THROWS(napi_create_external(env, manager,
+                                          FinalizeShared<leveldb::WriteBufferManager>,
+                                          NULL, &result));
+  return result;
+}
+
+/**
+ * Returns the total size of the write buffers under a budget.
+ */
+NAPI_METHOD(write_buffer_manager_usage) {
+  NAPI_ARGV(1);
+  SharedWriteBufferManager* manager = NULL;
+  NAPI_STATUS_THROWS(napi_get_value_external(env, argv[0], (void**)&manager));
+
+  napi_value result;
+  napi_create_double(env, (double)manager->object_->memory_usage(), &result);
+  return result;
+}
+
 /**
  * Worker class for opening a database.
  */
@@ -765,24 +1590,61 @@ struct OpenWorker final : public BaseWorker {
               bool errorIfExists,
               bool compression,
               uint32_t writeBufferSize,
+              double memtableBloomSizeRatio,
               uint32_t blockSize,
               uint32_t maxOpenFiles,
               uint32_t blockRestartInterval,
-              uint32_t maxFileSize)
+              uint32_t maxFileSize,
+              uint32_t compactionThreads,
+              uint32_t subcompactions,
+              uint32_t maxImmutableMemtables,
+              uint32_t l0CompactionTrigger,
+              uint32_t l0SlowdownWritesTrigger,
+              uint32_t delayedWriteRate,
+              uint32_t l0StopWritesTrigger,
+              uint32_t maxMemCompactLevel,
+              uint32_t levelSizeMultiplier,
+              bool dynamicLevelSizes,
+              bool cacheIndexAndFilterBlocks,
+              bool pinL0IndexAndFilterBlocks,
+              bool partitionIndexAndFilters,
+              bool dataBlockHashIndex,
+              bool wholeTableFilter)
     : BaseWorker(env, database, callback, "leveldown.db.open"),
       location_(location) {
     options_.block_cache = database->blockCache_;
     options_.filter_policy = database->filterPolicy_;
+    options_.prefix_extractor = database->prefixExtractor_;
+    options_.write_stall_listener = database->stallMonitor_;
+    if (database->writeBufferManager_ != NULL) {
+      options_.write_buffer_manager = database->writeBufferManager_->object_;
+    }
     options_.create_if_missing = createIfMissing;
     options_.error_if_exists = errorIfExists;
     options_.compression = compression
       ? leveldb::kSnappyCompression
       : leveldb::kNoCompression;
     options_.write_buffer_size = writeBufferSize;
+    options_.memtable_bloom_size_ratio = memtableBloomSizeRatio;
     options_.block_size = blockSize;
     options_.max_open_files = maxOpenFiles;
     options_.block_restart_interval = blockRestartInterval;
     options_.max_file_size = maxFileSize;
+    options_.max_background_compactions = compactionThreads;
+    options_.max_subcompactions = subcompactions;
+    options_.max_immutable_memtables = maxImmutableMemtables;
+    options_.l0_compaction_trigger = l0CompactionTrigger;
+    options_.l0_slowdown_writes_trigger = l0SlowdownWritesTrigger;
+    options_.delayed_write_rate = delayedWriteRate;
+    options_.l0_stop_writes_trigger = l0StopWritesTrigger;
+    options_.max_mem_compact_level = maxMemCompactLevel;
+    options_.level_size_multiplier = levelSizeMultiplier;
+    options_.dynamic_level_sizes = dynamicLevelSizes;
+    options_.cache_index_and_filter_blocks = cacheIndexAndFilterBlocks;
+    options_.pin_l0_index_and_filter_blocks = pinL0IndexAndFilterBlocks;
+    options_.partition_index_and_filters = partitionIndexAndFilters;
+    options_.data_block_hash_index = dataBlockHashIndex;
+    options_.whole_table_filter = wholeTableFilter;
   }
 
   ~OpenWorker () {}
@@ -809,21 +1671,124 @@ NAPI_METHOD(db_open) {
   bool compression = BooleanProperty(env, options, "compression", true);
 
   uint32_t cacheSize = Uint32Property(env, options, "cacheSize", 8 << 20);
+  std::string cachePolicy = StringProperty(env, options, "cachePolicy");
+  uint32_t cacheShards = Uint32Property(env, options, "cacheShards", 16);
   uint32_t writeBufferSize = Uint32Property(env, options , "writeBufferSize" , 4 << 20);
+  double memtableBloomSizeRatio = DoubleProperty(env, options,
+                                                 "memtableBloomSizeRatio", 0);
   uint32_t blockSize = Uint32Property(env, options, "blockSize", 4096);
   uint32_t maxOpenFiles = Uint32Property(env, options, "maxOpenFiles", 1000);
   uint32_t blockRestartInterval = Uint32Property(env, options,
                                                  "blockRestartInterval", 16);
   uint32_t maxFileSize = Uint32Property(env, options, "maxFileSize", 2 << 20);
+  uint32_t bloomBitsPerKey = Uint32Property(env, options, "bloomBitsPerKey", 10);
+  bool blockedBloomFilter = BooleanProperty(env, options, "blockedBloomFilter",
+                                            false);
+  bool wholeTableFilter = BooleanProperty(env, options, "wholeTableFilter",
+                                          false);
+  uint32_t prefixLength = Uint32Property(env, options, "prefixLength", 0);
+  std::string prefixDelimiter = StringProperty(env, options, "prefixDelimiter");
+  uint32_t prefixDelimiterCount = Uint32Property(env, options,
+                                                 "prefixDelimiterCount", 1);
+  uint32_t compactionThreads = Uint32Property(env, options,
+                                              "compactionThreads", 1);
+  uint32_t subcompactions = Uint32Property(env, options, "subcompactions", 1);
+  uint32_t maxImmutableMemtables = Uint32Property(env, options,
+                                                  "maxImmutableMemtables", 1);
+  uint32_t l0CompactionTrigger = Uint32Property(env, options,
+                                                "l0CompactionTrigger", 4);
+  uint32_t l0SlowdownWritesTrigger = Uint32Property(env, options,
+                                                    "l0SlowdownWritesTrigger", 8);
+  uint32_t delayedWriteRate = Uint32Property(env, options, "delayedWriteRate",
+                                             16 << 20);
+  uint32_t l0StopWritesTrigger = Uint32Property(env, options,
+                                                "l0StopWritesTrigger", 12);
+  uint32_t maxMemCompactLevel = Uint32Property(env, options,
+                                               "maxMemCompactLevel", 2);
+  uint32_t levelSizeMultiplier = Uint32Property(env, options,
+                                                "levelSizeMultiplier", 10);
+  bool dynamicLevelSizes = BooleanProperty(env, options, "dynamicLevelSizes",
+                                           false);
+  bool cacheIndexAndFilterBlocks = BooleanProperty(env, options,
+                                                   "cacheIndexAndFilterBlocks",
+                                                   false);
+  bool pinL0IndexAndFilterBlocks = BooleanProperty(env, options,
+                                                   "pinL0IndexAndFilterBlocks",
+                                                   false);
+  bool partitionIndexAndFilters = BooleanProperty(env, options,
+                                                  "partitionIndexAndFilters",
+                                                  false);
+  bool dataBlockHashIndex = BooleanProperty(env, options, "dataBlockHashIndex",
+                                            false);
+  uint32_t readThreads = Uint32Property(env, options, "readThreads", 0);
+  uint32_t writeThreads = Uint32Property(env, options, "writeThreads", 0);
+  database->coalesceWrites_ = BooleanProperty(env, options, "coalesceWrites",
+                                              false);
+
+  // Release what a previous, failed open left behind.
+  database->CloseDatabase();
+
+  SharedCache* cache = (SharedCache*)ExternalProperty(env, options, "cache");
+  if (cache != NULL) {
+    cache->Ref();
+    database->sharedCache_ = cache;
+    database->blockCache_ = cache->object_;
+  } else {
+    database->blockCache_ = NewBlockCache(cacheSize, cachePolicy, cacheShards);
+  }
 
-  database->blockCache_ = leveldb::NewLRUCache(cacheSize);
+  SharedWriteBufferManager* manager =
+    (SharedWriteBufferManager*)ExternalProperty(env, options,
+                                                "writeBufferManager");
+  if (manager != NULL) {
+    manager->Ref();
+    database->writeBufferManager_ = manager;
+  }
+
+  // The database is closed, so the filter policy of a previous open is unused.
+  delete database->filterPolicy_;
+  if (bloomBitsPerKey == 0) {
+    database->filterPolicy_ = NULL;
+  } else if (blockedBloomFilter) {
+    database->filterPolicy_ = leveldb::NewBlockedBloomFilterPolicy(
+      static_cast<int>(bloomBitsPerKey));
+  } else {
+    database->filterPolicy_ = leveldb::NewBloomFilterPolicy(
+      static_cast<int>(bloomBitsPerKey));
+  }
+  delete database->prefixExtractor_;
+  if (prefixDelimiter.size() == 1 && prefixDelimiterCount > 0) {
+    database->prefixExtractor_ = leveldb::NewDelimitedPrefixExtractor(
+      prefixDelimiter[0], static_cast<int>(prefixDelimiterCount));
+  } else if (prefixLength > 0) {
+    database->prefixExtractor_ = leveldb::NewFixedPrefixExtractor(prefixLength);
+  } else {
+    database->prefixExtractor_ = NULL;
+  }
+
+  database->stallMonitor_->Reset();
+
+  database->DestroyPool();
+  if (readThreads > 0 || writeThreads > 0) {
+    database->pool_ = new WorkerPool(env, readThreads, writeThreads);
+  }
 
   napi_value callback = argv[3];
   OpenWorker* worker = new OpenWorker(env, database, callback, location,
                                       createIfMissing, errorIfExists,
-                                      compression, writeBufferSize, blockSize,
+                                      compression, writeBufferSize,
+                                      memtableBloomSizeRatio, blockSize,
                                       maxOpenFiles, blockRestartInterval,
-                                      maxFileSize);
+                                      maxFileSize, compactionThreads,
+                                      subcompactions, maxImmutableMemtables,
+                                      l0CompactionTrigger,
+                                      l0SlowdownWritesTrigger, delayedWriteRate,
+                                      l0StopWritesTrigger, maxMemCompactLevel,
+                                      levelSizeMultiplier, dynamicLevelSizes,
+                                      cacheIndexAndFilterBlocks,
+                                      pinL0IndexAndFilterBlocks,
+                                      partitionIndexAndFilters,
+                                      dataBlockHashIndex, wholeTableFilter);
   worker->Queue();
   delete [] location;
 
@@ -844,6 +1809,15 @@ struct CloseWorker final : public BaseWorker {
   void DoExecute () override {
     database_->CloseDatabase();
   }
+
+  /**
+   * Destroys the pool before the callback, which may open the database again
+   * with a new pool.
+   */
+  void HandleOKCallback () override {
+    database_->DestroyPool();
+    BaseWorker::HandleOKCallback();
+  }
 };
 
 napi_value noop_callback (napi_env env, napi_callback_info info) {
@@ -865,19 +1839,109 @@ NAPI_METHOD(db_close) {
     NAPI_RETURN_UNDEFINED();
   }
 
-  database->pendingCloseWorker_ = worker;
+  database->pendingCloseWorker_ = worker;
+
+  napi_value noop;
+  napi_create_function(env, NULL, 0, noop_callback, NULL, &noop);
+
+  std::map<uint32_t, Iterator*> iterators = database->iterators_;
+  std::map<uint32_t, Iterator*>::iterator it;
+
+  for (it = iterators.begin(); it != iterators.end(); ++it) {
+    iterator_end_do(env, it->second, noop);
+  }
+
+  NAPI_RETURN_UNDEFINED();
+}
+
+/**
+ * Worker class for writing many puts, dels and batches in one WriteBatch, if
+ * the coalesceWrites option is set. Writes that are made while a previous
+ * write group is in flight are added to the next group, which is written once
+ * the previous group completes. This saves LevelDB from waking up a writer
+ * thread for every small write.
+ */
+struct WriteGroupWorker final : public PriorityWorker {
+  WriteGroupWorker (napi_env env,
+                    Database* database,
+                    napi_value callback)
+    : PriorityWorker(env, database, callback, "leveldown.db.write_group"),
+      sync_(false) {}
+
+  ~WriteGroupWorker () {
+    for (size_t i = 0; i < callbacks_.size(); i++) {
+      napi_delete_reference(env_, callbacks_[i]);
+    }
+  }
+
+  void Add (napi_value callback, bool sync) {
+    napi_ref ref;
+    napi_create_reference(env_, callback, 1, &ref);
+    callbacks_.push_back(ref);
+    if (sync) sync_ = true;
+  }
+
+  WorkerKind Kind () override { return kWriteWork; }
+
+  void DoExecute () override {
+    if (leveldb::WriteBatchInternal::Count(&batch_) > 0) {
+      leveldb::WriteOptions options;
+      options.sync = sync_;
+      writeStatus_ = database_->WriteBatch(options, &batch_);
+    }
+  }
+
+  void HandleOKCallback () override;
+
+  leveldb::WriteBatch batch_;
+  std::vector<napi_ref> callbacks_;
+  bool sync_;
+  leveldb::Status writeStatus_;
+};
+
+/**
+ * Returns the write group that new writes should be added to.
+ */
+static WriteGroupWorker* OpenWriteGroup (napi_env env,
+                                         Database* database,
+                                         napi_value callback) {
+  if (database->writeGroup_ == NULL) {
+    database->writeGroup_ = new WriteGroupWorker(env, database, callback);
+  }
+
+  return database->writeGroup_;
+}
+
+/**
+ * Queues the open write group, unless a previous group is still in flight.
+ * Only one group is written at a time so that groups are committed and
+ * called back in order; the open group keeps growing meanwhile.
+ */
+static void MaybeFlushWriteGroup (Database* database) {
+  WriteGroupWorker* group = database->writeGroup_;
+  if (group == NULL || database->writeGroupInFlight_) return;
 
-  napi_value noop;
-  napi_create_function(env, NULL, 0, noop_callback, NULL, &noop);
+  database->writeGroup_ = NULL;
+  database->writeGroupInFlight_ = true;
+  group->Queue();
+}
 
-  std::map<uint32_t, Iterator*> iterators = database->iterators_;
-  std::map<uint32_t, Iterator*>::iterator it;
+void WriteGroupWorker::HandleOKCallback () {
+  database_->writeGroupInFlight_ = false;
+  MaybeFlushWriteGroup(database_);
 
-  for (it = iterators.begin(); it != iterators.end(); ++it) {
-    iterator_end_do(env, it->second, noop);
+  napi_value argv;
+  if (writeStatus_.ok()) {
+    napi_get_null(env_, &argv);
+  } else {
+    argv = CreateError(env_, writeStatus_.ToString().c_str());
   }
 
-  NAPI_RETURN_UNDEFINED();
+  for (size_t i = 0; i < callbacks_.size(); i++) {
+    napi_value callback;
+    napi_get_reference_value(env_, callbacks_[i], &callback);
+    CallFunction(env_, callback, 1, &argv);
+  }
 }
 
 /**
@@ -888,25 +1952,31 @@ struct PutWorker final : public PriorityWorker {
              Database* database,
              napi_value callback,
              leveldb::Slice key,
+             napi_ref keyRef,
              leveldb::Slice value,
+             napi_ref valueRef,
              bool sync)
     : PriorityWorker(env, database, callback, "leveldown.db.put"),
-      key_(key), value_(value) {
+      key_(key), keyRef_(keyRef), value_(value), valueRef_(valueRef) {
     options_.sync = sync;
   }
 
   ~PutWorker () {
-    DisposeSliceBuffer(key_);
-    DisposeSliceBuffer(value_);
+    DisposeSliceOrRef(env_, key_, keyRef_);
+    DisposeSliceOrRef(env_, value_, valueRef_);
   }
 
+  WorkerKind Kind () override { return kWriteWork; }
+
   void DoExecute () override {
     SetStatus(database_->Put(options_, key_, value_));
   }
 
   leveldb::WriteOptions options_;
   leveldb::Slice key_;
+  napi_ref keyRef_;
   leveldb::Slice value_;
+  napi_ref valueRef_;
 };
 
 /**
@@ -916,12 +1986,28 @@ NAPI_METHOD(db_put) {
   NAPI_ARGV(5);
   NAPI_DB_CONTEXT();
 
-  leveldb::Slice key = ToSlice(env, argv[1]);
-  leveldb::Slice value = ToSlice(env, argv[2]);
   bool sync = BooleanProperty(env, argv[3], "sync", false);
   napi_value callback = argv[4];
 
-  PutWorker* worker = new PutWorker(env, database, callback, key, value, sync);
+  if (database->coalesceWrites_) {
+    WriteGroupWorker* group = OpenWriteGroup(env, database, callback);
+    std::string keyScratch;
+    std::string valueScratch;
+    group->batch_.Put(ToTransientSlice(env, argv[1], keyScratch),
+                      ToTransientSlice(env, argv[2], valueScratch));
+    group->Add(callback, sync);
+    MaybeFlushWriteGroup(database);
+
+    NAPI_RETURN_UNDEFINED();
+  }
+
+  napi_ref keyRef;
+  napi_ref valueRef;
+  leveldb::Slice key = ToSliceOrRef(env, argv[1], &keyRef);
+  leveldb::Slice value = ToSliceOrRef(env, argv[2], &valueRef);
+
+  PutWorker* worker = new PutWorker(env, database, callback, key, keyRef,
+                                    value, valueRef, sync);
   worker->Queue();
 
   NAPI_RETURN_UNDEFINED();
@@ -947,6 +2033,8 @@ struct GetWorker final : public PriorityWorker {
     DisposeSliceBuffer(key_);
   }
 
+  WorkerKind Kind () override { return kReadWork; }
+
   void DoExecute () override {
     SetStatus(database_->Get(options_, key_, value_));
   }
@@ -956,7 +2044,7 @@ struct GetWorker final : public PriorityWorker {
     napi_get_null(env_, &argv[0]);
 
     if (asBuffer_) {
-      napi_create_buffer_copy(env_, value_.size(), value_.data(), NULL, &argv[1]);
+      NewBuffer(env_, value_, &argv[1]);
     } else {
       napi_create_string_utf8(env_, value_.data(), value_.size(), &argv[1]);
     }
@@ -992,6 +2080,166 @@ NAPI_METHOD(db_get) {
   NAPI_RETURN_UNDEFINED();
 }
 
+/**
+ * Gets a value from a database on the main thread, if that can be done
+ * without file I/O, i.e. if the value is in a memtable or in the block cache.
+ * Returns the value, undefined if the key was not found or null if the value
+ * must be read with db_get instead.
+ */
+NAPI_METHOD(db_try_get) {
+  NAPI_ARGV(3);
+  NAPI_DB_CONTEXT();
+
+  std::string keyScratch;
+  leveldb::Slice key = ToTransientSlice(env, argv[1], keyScratch);
+  napi_value options = argv[2];
+  bool asBuffer = BooleanProperty(env, options, "asBuffer", true);
+
+  leveldb::ReadOptions readOptions;
+  readOptions.fill_cache = BooleanProperty(env, options, "fillCache", true);
+  readOptions.no_io = true;
+
+  std::string value;
+  leveldb::Status status = database->Get(readOptions, key, value);
+
+  napi_value result;
+
+  if (status.ok()) {
+    if (asBuffer) {
+      NewBuffer(env, value, &result);
+    } else {
+      napi_create_string_utf8(env, value.data(), value.size(), &result);
+    }
+  } else if (status.IsNotFound()) {
+    napi_get_undefined(env, &result);
+  } else if (status.IsIncomplete()) {
+    napi_get_null(env, &result);
+  } else {
+    napi_throw_error(env, NULL, status.ToString().c_str());
+    return NULL;
+  }
+
+  return result;
+}
+
+/**
+ * Worker class for getting many values from a database.
+ */
+struct GetManyWorker final : public PriorityWorker {
+  GetManyWorker (napi_env env,
+                 Database* database,
+                 napi_value callback,
+                 const std::vector<leveldb::Slice>& keys,
+                 bool asBuffer,
+                 bool fillCache)
+    : PriorityWorker(env, database, callback, "leveldown.db.get_many"),
+      keys_(keys),
+      asBuffer_(asBuffer) {
+    options_.fill_cache = fillCache;
+    options_.snapshot = database->NewSnapshot();
+  }
+
+  ~GetManyWorker () {
+    for (size_t i = 0; i < keys_.size(); i++) {
+      DisposeSliceBuffer(keys_[i]);
+    }
+  }
+
+  WorkerKind Kind () override { return kReadWork; }
+
+  void DoExecute () override {
+    cache_.reserve(keys_.size());
+
+    for (size_t i = 0; i < keys_.size(); i++) {
+      std::string* value = new std::string();
+      leveldb::Status status = database_->Get(options_, keys_[i], *value);
+
+      if (status.ok()) {
+        cache_.push_back(value);
+      } else if (status.IsNotFound()) {
+        delete value;
+        cache_.push_back(NULL);
+      } else {
+        delete value;
+        for (size_t j = 0; j < cache_.size(); j++) {
+          if (cache_[j] != NULL) delete cache_[j];
+        }
+        cache_.clear();
+        SetStatus(status);
+        break;
+      }
+    }
+
+    database_->ReleaseSnapshot(options_.snapshot);
+  }
+
+  void HandleOKCallback () override {
+    size_t size = cache_.size();
+    napi_value array;
+    napi_create_array_with_length(env_, size, &array);
+
+    for (size_t idx = 0; idx < size; idx++) {
+      std::string* value = cache_[idx];
+      napi_value element;
+
+      if (value == NULL) {
+        napi_get_undefined(env_, &element);
+      } else if (asBuffer_) {
+        NewBuffer(env_, *value, &element);
+      } else {
+        napi_create_string_utf8(env_, value->data(), value->size(), &element);
+      }
+
+      napi_set_element(env_, array, static_cast<uint32_t>(idx), element);
+      if (value != NULL) delete value;
+    }
+
+    napi_value argv[2];
+    napi_get_null(env_, &argv[0]);
+    argv[1] = array;
+    napi_value callback;
+    napi_get_reference_value(env_, callbackRef_, &callback);
+    CallFunction(env_, callback, 2, argv);
+  }
+
+  leveldb::ReadOptions options_;
+  std::vector<leveldb::Slice> keys_;
+  std::vector<std::string*> cache_;
+  bool asBuffer_;
+};
+
+/**
+ * Gets many values from a database.
+ */
+NAPI_METHOD(db_get_many) {
+  NAPI_ARGV(4);
+  NAPI_DB_CONTEXT();
+
+  napi_value array = argv[1];
+  napi_value options = argv[2];
+  bool asBuffer = BooleanProperty(env, options, "asBuffer", true);
+  bool fillCache = BooleanProperty(env, options, "fillCache", true);
+  napi_value callback = argv[3];
+
+  uint32_t length;
+  NAPI_STATUS_THROWS(napi_get_array_length(env, array, &length));
+
+  std::vector<leveldb::Slice> keys;
+  keys.reserve(length);
+
+  for (uint32_t i = 0; i < length; i++) {
+    napi_value element;
+    napi_get_element(env, array, i, &element);
+    keys.push_back(ToSlice(env, element));
+  }
+
+  GetManyWorker* worker = new GetManyWorker(env, database, callback, keys,
+                                            asBuffer, fillCache);
+  worker->Queue();
+
+  NAPI_RETURN_UNDEFINED();
+}
+
 /**
  * Worker class for deleting a value from a database.
  */
@@ -1000,22 +2248,26 @@ struct DelWorker final : public PriorityWorker {
              Database* database,
              napi_value callback,
              leveldb::Slice key,
+             napi_ref keyRef,
              bool sync)
     : PriorityWorker(env, database, callback, "leveldown.db.del"),
-      key_(key) {
+      key_(key), keyRef_(keyRef) {
     options_.sync = sync;
   }
 
   ~DelWorker () {
-    DisposeSliceBuffer(key_);
+    DisposeSliceOrRef(env_, key_, keyRef_);
   }
 
+  WorkerKind Kind () override { return kWriteWork; }
+
   void DoExecute () override {
     SetStatus(database_->Del(options_, key_));
   }
 
   leveldb::WriteOptions options_;
   leveldb::Slice key_;
+  napi_ref keyRef_;
 };
 
 /**
@@ -1025,11 +2277,23 @@ NAPI_METHOD(db_del) {
   NAPI_ARGV(4);
   NAPI_DB_CONTEXT();
 
-  leveldb::Slice key = ToSlice(env, argv[1]);
   bool sync = BooleanProperty(env, argv[2], "sync", false);
   napi_value callback = argv[3];
 
-  DelWorker* worker = new DelWorker(env, database, callback, key, sync);
+  if (database->coalesceWrites_) {
+    WriteGroupWorker* group = OpenWriteGroup(env, database, callback);
+    std::string keyScratch;
+    group->batch_.Delete(ToTransientSlice(env, argv[1], keyScratch));
+    group->Add(callback, sync);
+    MaybeFlushWriteGroup(database);
+
+    NAPI_RETURN_UNDEFINED();
+  }
+
+  napi_ref keyRef;
+  leveldb::Slice key = ToSliceOrRef(env, argv[1], &keyRef);
+
+  DelWorker* worker = new DelWorker(env, database, callback, key, keyRef, sync);
   worker->Queue();
 
   NAPI_RETURN_UNDEFINED();
@@ -1052,6 +2316,8 @@ struct ApproximateSizeWorker final : public PriorityWorker {
     DisposeSliceBuffer(end_);
   }
 
+  WorkerKind Kind () override { return kReadWork; }
+
   void DoExecute () override {
     leveldb::Range range(start_, end_);
     size_ = database_->ApproximateSize(&range);
@@ -1108,6 +2374,8 @@ struct CompactRangeWorker final : public PriorityWorker {
     DisposeSliceBuffer(end_);
   }
 
+  WorkerKind Kind () override { return kWriteWork; }
+
   void DoExecute () override {
     database_->CompactRange(&start_, &end_);
   }
@@ -1154,6 +2422,31 @@ NAPI_METHOD(db_get_property) {
   return result;
 }
 
+/**
+ * Returns whether writes are delayed or stopped, and why.
+ */
+NAPI_METHOD(db_write_stall_state) {
+  NAPI_ARGV(1);
+  NAPI_DB_CONTEXT();
+
+  return database->stallMonitor_->State(env);
+}
+
+/**
+ * Sets the function that is called when writes start or stop being delayed
+ * or stopped, or removes it if null.
+ */
+NAPI_METHOD(db_set_write_stall_listener) {
+  NAPI_ARGV(2);
+  NAPI_DB_CONTEXT();
+
+  napi_valuetype type;
+  napi_typeof(env, argv[1], &type);
+  database->stallMonitor_->SetListener(type == napi_function ? argv[1] : NULL);
+
+  NAPI_RETURN_UNDEFINED();
+}
+
 /**
  * Worker class for destroying a database.
  */
@@ -1260,9 +2553,11 @@ NAPI_METHOD(iterator_init) {
   bool fillCache = BooleanProperty(env, options, "fillCache", false);
   bool keyAsBuffer = BooleanProperty(env, options, "keyAsBuffer", true);
   bool valueAsBuffer = BooleanProperty(env, options, "valueAsBuffer", true);
+  bool packed = BooleanProperty(env, options, "packed", false);
   int limit = Int32Property(env, options, "limit", -1);
   uint32_t highWaterMark = Uint32Property(env, options, "highWaterMark",
                                           16 * 1024);
+  uint32_t prefetch = Uint32Property(env, options, "prefetch", 0);
 
   // TODO simplify and refactor the hideous code below
 
@@ -1343,10 +2638,17 @@ NAPI_METHOD(iterator_init) {
     }
   });
 
+  std::string* prefix = NULL;
+  CHECK_PROPERTY(prefix, {
+    prefix = new std::string(_prefixCh_, _prefixSz_);
+    delete [] _prefixCh_;
+  });
+
   uint32_t id = database->currentIteratorId_++;
   Iterator* iterator = new Iterator(database, id, start, end, reverse, keys,
                                     values, limit, lt, lte, gt, gte, fillCache,
-                                    keyAsBuffer, valueAsBuffer, highWaterMark);
+                                    keyAsBuffer, valueAsBuffer, packed,
+                                    highWaterMark, prefetch, prefix);
   napi_value result;
   napi_ref ref;
 
@@ -1375,46 +2677,14 @@ NAPI_METHOD(iterator_seek) {
 
   iterator->ReleaseTarget();
   iterator->target_ = new leveldb::Slice(ToSlice(env, argv[1]));
-  iterator->GetIterator();
-
-  leveldb::Iterator* dbIterator = iterator->dbIterator_;
-  dbIterator->Seek(*iterator->target_);
+  iterator->ReleaseChunks(env);
+  iterator->finished_ = false;
 
-  iterator->seeking_ = true;
-  iterator->landed_ = false;
-
-  if (iterator->OutOfRange(iterator->target_)) {
-    if (iterator->reverse_) {
-      dbIterator->SeekToFirst();
-      dbIterator->Prev();
-    } else {
-      dbIterator->SeekToLast();
-      dbIterator->Next();
-    }
-  }
-  else if (dbIterator->Valid()) {
-    int cmp = dbIterator->key().compare(*iterator->target_);
-    if (cmp > 0 && iterator->reverse_) {
-      dbIterator->Prev();
-    } else if (cmp < 0 && !iterator->reverse_) {
-      dbIterator->Next();
-    }
+  if (iterator->nexting_) {
+    // Can't touch the leveldb iterator while a chunk is being read ahead.
+    iterator->seekPending_ = true;
   } else {
-    if (iterator->reverse_) {
-      dbIterator->SeekToLast();
-    } else {
-      dbIterator->SeekToFirst();
-    }
-    if (dbIterator->Valid()) {
-      int cmp = dbIterator->key().compare(*iterator->target_);
-      if (cmp > 0 && iterator->reverse_) {
-        dbIterator->SeekToFirst();
-        dbIterator->Prev();
-      } else if (cmp < 0 && !iterator->reverse_) {
-        dbIterator->SeekToLast();
-        dbIterator->Next();
-      }
-    }
+    iterator->Seek();
   }
 
   NAPI_RETURN_UNDEFINED();
@@ -1432,6 +2702,8 @@ struct EndWorker final : public BaseWorker {
 
   ~EndWorker () {}
 
+  WorkerKind Kind () override { return kReadWork; }
+
   void DoExecute () override {
     iterator_->IteratorEnd();
   }
@@ -1452,6 +2724,7 @@ static void iterator_end_do (napi_env env, Iterator* iterator, napi_value cb) {
   if (!iterator->ended_) {
     EndWorker* worker = new EndWorker(env, iterator, cb);
     iterator->ended_ = true;
+    iterator->ReleaseChunks(env);
 
     if (iterator->nexting_) {
       iterator->endWorker_ = worker;
@@ -1474,60 +2747,133 @@ NAPI_METHOD(iterator_end) {
 }
 
 /**
- * TODO Move this to Iterator. There isn't any reason
- * for this function being a separate function pointer.
+ * Calls 'callback' with the arguments stored in 'chunk'.
  */
-void CheckEndCallback (Iterator* iterator) {
-  iterator->ReleaseTarget();
-  iterator->nexting_ = false;
-  if (iterator->endWorker_ != NULL) {
-    iterator->endWorker_->Queue();
-    iterator->endWorker_ = NULL;
+static void iterator_call_chunk (napi_env env, napi_value chunk,
+                                 napi_value callback) {
+  uint32_t argc = 0;
+  napi_value argv[4];
+  napi_get_array_length(env, chunk, &argc);
+
+  for (uint32_t i = 0; i < argc && i < 4; i++) {
+    napi_get_element(env, chunk, i, &argv[i]);
   }
+
+  CallFunction(env, callback, argc, argv);
 }
 
+static void iterator_prefetch (napi_env env, Iterator* iterator);
+
 /**
- * Worker class for nexting an iterator.
+ * Worker class for nexting an iterator. Reads a chunk of entries, which is
+ * either passed to the JS callback that is waiting for it or kept until
+ * the next call to NAPI_METHOD(iterator_next).
  */
 struct NextWorker final : public BaseWorker {
   NextWorker (napi_env env,
-              Iterator* iterator,
-              napi_value callback,
-              void (*localCallback)(Iterator*))
-    : BaseWorker(env, iterator->database_, callback,
+              Iterator* iterator)
+    : BaseWorker(env, iterator->database_, iterator->Handle(env),
                  "leveldown.iterator.next"),
-      iterator_(iterator),
-      localCallback_(localCallback) {}
+      iterator_(iterator) {}
 
   ~NextWorker () {}
 
+  WorkerKind Kind () override { return kReadWork; }
+
   void DoExecute () override {
-    ok_ = iterator_->IteratorNext(result_);
+    if (iterator_->packed_) {
+      ok_ = iterator_->IteratorNextPacked(data_, offsets_);
+    } else {
+      ok_ = iterator_->IteratorNext(result_);
+    }
     if (!ok_) {
-      SetStatus(iterator_->IteratorStatus());
+      iteratorStatus_ = iterator_->IteratorStatus();
     }
   }
 
   void HandleOKCallback () override {
+    napi_value chunk;
+
+    if (!iteratorStatus_.ok()) {
+      napi_create_array_with_length(env_, 1, &chunk);
+      napi_value error = CreateError(env_, iteratorStatus_.ToString().c_str());
+      napi_set_element(env_, chunk, 0, error);
+    } else if (iterator_->packed_) {
+      chunk = CreatePackedChunk();
+    } else {
+      chunk = CreateChunk();
+    }
+
+    Iterator* iterator = iterator_;
+    iterator->nexting_ = false;
+    if (!ok_) iterator->finished_ = true;
+
+    napi_value callback = NULL;
+
+    if (iterator->seekPending_) {
+      // This chunk is stale. Seek now that the leveldb iterator is ours again.
+      iterator->seekPending_ = false;
+      iterator->finished_ = false;
+      iterator->Seek();
+    } else if (iterator->nextCallbackRef_ != NULL) {
+      napi_get_reference_value(env_, iterator->nextCallbackRef_, &callback);
+      napi_delete_reference(env_, iterator->nextCallbackRef_);
+      iterator->nextCallbackRef_ = NULL;
+    } else if (!iterator->ended_) {
+      napi_ref ref;
+      napi_create_reference(env_, chunk, 1, &ref);
+      iterator->chunks_.push_back(ref);
+    }
+
+    iterator->ReleaseTarget();
+    if (iterator->endWorker_ != NULL) {
+      iterator->endWorker_->Queue();
+      iterator->endWorker_ = NULL;
+    }
+
+    if (iterator->nextCallbackRef_ != NULL) {
+      // A JS callback is still waiting, because this chunk was stale.
+      if (iterator->ended_) {
+        napi_get_reference_value(env_, iterator->nextCallbackRef_, &callback);
+        napi_delete_reference(env_, iterator->nextCallbackRef_);
+        iterator->nextCallbackRef_ = NULL;
+        napi_create_array_with_length(env_, 1, &chunk);
+        napi_set_element(env_, chunk, 0, CreateError(env_, "iterator has ended"));
+      } else {
+        iterator->nexting_ = true;
+        (new NextWorker(env_, iterator))->Queue();
+      }
+    }
+
+    iterator_prefetch(env_, iterator);
+
+    if (callback != NULL) {
+      iterator_call_chunk(env_, chunk, callback);
+    }
+  }
+
+  /**
+   * Returns the callback arguments for a chunk of entries.
+   */
+  napi_value CreateChunk () {
     size_t arraySize = result_.size() * 2;
     napi_value jsArray;
     napi_create_array_with_length(env_, arraySize, &jsArray);
 
     for (size_t idx = 0; idx < result_.size(); ++idx) {
-      std::pair<std::string, std::string> row = result_[idx];
-      std::string key = row.first;
-      std::string value = row.second;
+      std::string& key = result_[idx].first;
+      std::string& value = result_[idx].second;
 
       napi_value returnKey;
       if (iterator_->keyAsBuffer_) {
-        napi_create_buffer_copy(env_, key.size(), key.data(), NULL, &returnKey);
+        NewBuffer(env_, key, &returnKey);
       } else {
         napi_create_string_utf8(env_, key.data(), key.size(), &returnKey);
       }
 
       napi_value returnValue;
       if (iterator_->valueAsBuffer_) {
-        napi_create_buffer_copy(env_, value.size(), value.data(), NULL, &returnValue);
+        NewBuffer(env_, value, &returnValue);
       } else {
         napi_create_string_utf8(env_, value.data(), value.size(), &returnValue);
       }
@@ -1537,26 +2883,66 @@ struct NextWorker final : public BaseWorker {
       napi_set_element(env_, jsArray, static_cast<int>(arraySize - idx * 2 - 2), returnValue);
     }
 
-    // clean up & handle the next/end state
-    // TODO this should just do iterator_->CheckEndCallback();
-    localCallback_(iterator_);
-
-    napi_value argv[3];
-    napi_get_null(env_, &argv[0]);
-    argv[1] = jsArray;
-    napi_get_boolean(env_, !ok_, &argv[2]);
-    napi_value callback;
-    napi_get_reference_value(env_, callbackRef_, &callback);
-    CallFunction(env_, callback, 3, argv);
+    napi_value chunk;
+    napi_create_array_with_length(env_, 3, &chunk);
+    napi_value element;
+    napi_get_null(env_, &element);
+    napi_set_element(env_, chunk, 0, element);
+    napi_set_element(env_, chunk, 1, jsArray);
+    napi_get_boolean(env_, !ok_, &element);
+    napi_set_element(env_, chunk, 2, element);
+    return chunk;
+  }
+
+  /**
+   * Returns the callback arguments for a packed chunk: a single buffer holding
+   * all keys and values, and a Uint32Array of offsets into it, to be sliced
+   * lazily in JS.
+   */
+  napi_value CreatePackedChunk () {
+    napi_value data;
+    NewBuffer(env_, data_, &data);
+
+    size_t byteLength = offsets_.size() * sizeof(uint32_t);
+    void* offsetsData = NULL;
+    napi_value offsetsBuffer;
+    napi_create_arraybuffer(env_, byteLength, &offsetsData, &offsetsBuffer);
+    if (byteLength > 0) memcpy(offsetsData, &offsets_[0], byteLength);
+
+    napi_value offsets;
+    napi_create_typedarray(env_, napi_uint32_array, offsets_.size(),
+                           offsetsBuffer, 0, &offsets);
+
+    napi_value chunk;
+    napi_create_array_with_length(env_, 4, &chunk);
+    napi_value element;
+    napi_get_null(env_, &element);
+    napi_set_element(env_, chunk, 0, element);
+    napi_set_element(env_, chunk, 1, data);
+    napi_get_boolean(env_, !ok_, &element);
+    napi_set_element(env_, chunk, 2, element);
+    napi_set_element(env_, chunk, 3, offsets);
+    return chunk;
   }
 
   Iterator* iterator_;
-  // TODO why do we need a function pointer for this?
-  void (*localCallback_)(Iterator*);
   std::vector<std::pair<std::string, std::string> > result_;
+  std::string data_;
+  std::vector<uint32_t> offsets_;
+  leveldb::Status iteratorStatus_;
   bool ok_;
 };
 
+/**
+ * Starts reading the next chunk ahead of time, if the iterator wants that.
+ */
+static void iterator_prefetch (napi_env env, Iterator* iterator) {
+  if (iterator->ShouldPrefetch()) {
+    iterator->nexting_ = true;
+    (new NextWorker(env, iterator))->Queue();
+  }
+}
+
 /**
  * Moves an iterator to next element.
  */
@@ -1573,10 +2959,28 @@ NAPI_METHOD(iterator_next) {
     NAPI_RETURN_UNDEFINED();
   }
 
-  NextWorker* worker = new NextWorker(env, iterator, callback,
-                                      CheckEndCallback);
-  iterator->nexting_ = true;
-  worker->Queue();
+  if (!iterator->chunks_.empty()) {
+    napi_ref ref = iterator->chunks_.front();
+    iterator->chunks_.pop_front();
+
+    napi_value chunk;
+    napi_get_reference_value(env, ref, &chunk);
+    napi_delete_reference(env, ref);
+
+    iterator_prefetch(env, iterator);
+    iterator_call_chunk(env, chunk, callback);
+
+    NAPI_RETURN_UNDEFINED();
+  }
+
+  NAPI_STATUS_THROWS(napi_create_reference(env, callback, 1,
+                                           &iterator->nextCallbackRef_));
+
+  // Otherwise the chunk being read ahead will be passed to the callback.
+  if (!iterator->nexting_) {
+    iterator->nexting_ = true;
+    (new NextWorker(env, iterator))->Queue();
+  }
 
   NAPI_RETURN_UNDEFINED();
 }
@@ -1600,6 +3004,8 @@ struct BatchWorker final : public PriorityWorker {
     delete batch_;
   }
 
+  WorkerKind Kind () override { return kWriteWork; }
+
   void DoExecute () override {
     if (hasData_) {
       SetStatus(database_->WriteBatch(options_, batch_));
@@ -1625,9 +3031,23 @@ NAPI_METHOD(batch_do) {
   uint32_t length;
   napi_get_array_length(env, array, &length);
 
-  leveldb::WriteBatch* batch = new leveldb::WriteBatch();
+  // Operations are added to the open write group, if writes are coalesced.
+  WriteGroupWorker* group = NULL;
+  leveldb::WriteBatch* batch;
+
+  if (database->coalesceWrites_) {
+    group = OpenWriteGroup(env, database, callback);
+    batch = &group->batch_;
+  } else {
+    batch = new leveldb::WriteBatch();
+  }
+
   bool hasData = false;
 
+  // Reused for every string key and value, the batch copies them anyway.
+  std::string keyScratch;
+  std::string valueScratch;
+
   for (uint32_t i = 0; i < length; i++) {
     napi_value element;
     napi_get_element(env, array, i, &element);
@@ -1638,33 +3058,119 @@ NAPI_METHOD(batch_do) {
 
     if (type == "del") {
       if (!HasProperty(env, element, "key")) continue;
-      leveldb::Slice key = ToSlice(env, GetProperty(env, element, "key"));
+      leveldb::Slice key = ToTransientSlice(env, GetProperty(env, element, "key"),
+                                            keyScratch);
 
       batch->Delete(key);
       if (!hasData) hasData = true;
-
-      DisposeSliceBuffer(key);
     } else if (type == "put") {
       if (!HasProperty(env, element, "key")) continue;
       if (!HasProperty(env, element, "value")) continue;
 
-      leveldb::Slice key = ToSlice(env, GetProperty(env, element, "key"));
-      leveldb::Slice value = ToSlice(env, GetProperty(env, element, "value"));
+      leveldb::Slice key = ToTransientSlice(env, GetProperty(env, element, "key"),
+                                            keyScratch);
+      leveldb::Slice value = ToTransientSlice(env, GetProperty(env, element, "value"),
+                                              valueScratch);
 
       batch->Put(key, value);
       if (!hasData) hasData = true;
-
-      DisposeSliceBuffer(key);
-      DisposeSliceBuffer(value);
     }
   }
 
+  if (group != NULL) {
+    group->Add(callback, sync);
+    MaybeFlushWriteGroup(database);
+
+    NAPI_RETURN_UNDEFINED();
+  }
+
   BatchWorker* worker = new BatchWorker(env, database, callback, batch, sync, hasData);
   worker->Queue();
 
   NAPI_RETURN_UNDEFINED();
 }
 
+/**
+ * WriteBatch handler that only checks that a batch can be decoded.
+ */
+struct BatchValidator final : public leveldb::WriteBatch::Handler {
+  void Put (const leveldb::Slice& key, const leveldb::Slice& value) override {}
+  void Delete (const leveldb::Slice& key) override {}
+};
+
+/**
+ * Worker class for writing a packed batch.
+ */
+struct PackedBatchWorker final : public PriorityWorker {
+  PackedBatchWorker (napi_env env,
+                     Database* database,
+                     napi_value callback,
+                     leveldb::WriteBatch* batch,
+                     bool sync)
+    : PriorityWorker(env, database, callback, "leveldown.batch.do_packed"),
+      batch_(batch) {
+    options_.sync = sync;
+  }
+
+  ~PackedBatchWorker () {
+    delete batch_;
+  }
+
+  WorkerKind Kind () override { return kWriteWork; }
+
+  void DoExecute () override {
+    // A malformed batch must not reach the log, it would break recovery.
+    BatchValidator validator;
+    leveldb::Status status = batch_->Iterate(&validator);
+
+    if (status.ok() && leveldb::WriteBatchInternal::Count(batch_) > 0) {
+      status = database_->WriteBatch(options_, batch_);
+    }
+
+    SetStatus(status);
+  }
+
+  leveldb::WriteOptions options_;
+  leveldb::WriteBatch* batch_;
+};
+
+/**
+ * Does a batch write operation on a database, with operations that have been
+ * packed into a buffer in the format of a WriteBatch (see packed-batch.js).
+ */
+NAPI_METHOD(batch_do_packed) {
+  NAPI_ARGV(4);
+  NAPI_DB_CONTEXT();
+
+  napi_value buffer = argv[1];
+  bool sync = BooleanProperty(env, argv[2], "sync", false);
+  napi_value callback = argv[3];
+
+  if (!IsBuffer(env, buffer)) {
+    napi_throw_error(env, NULL, "packed batch must be a buffer");
+    NAPI_RETURN_UNDEFINED();
+  }
+
+  char* data = 0;
+  size_t size = 0;
+  NAPI_STATUS_THROWS(napi_get_buffer_info(env, buffer, (void **)&data, &size));
+
+  // SetContents() asserts on anything shorter than the 12-byte header.
+  if (size < 12) {
+    napi_throw_error(env, NULL, "packed batch is too small");
+    NAPI_RETURN_UNDEFINED();
+  }
+
+  leveldb::WriteBatch* batch = new leveldb::WriteBatch();
+  leveldb::WriteBatchInternal::SetContents(batch, leveldb::Slice(data, size));
+
+  PackedBatchWorker* worker = new PackedBatchWorker(env, database, callback,
+                                                    batch, sync);
+  worker->Queue();
+
+  NAPI_RETURN_UNDEFINED();
+}
+
 /**
  * Owns a WriteBatch.
  */
@@ -1702,6 +3208,10 @@ struct Batch {
   Database* database_;
   leveldb::WriteBatch* batch_;
   bool hasData_;
+
+  // Reused for string keys and values, see ToTransientSlice().
+  std::string keyScratch_;
+  std::string valueScratch_;
 };
 
 /**
@@ -1736,11 +3246,9 @@ NAPI_METHOD(batch_put) {
   NAPI_ARGV(3);
   NAPI_BATCH_CONTEXT();
 
-  leveldb::Slice key = ToSlice(env, argv[1]);
-  leveldb::Slice value = ToSlice(env, argv[2]);
+  leveldb::Slice key = ToTransientSlice(env, argv[1], batch->keyScratch_);
+  leveldb::Slice value = ToTransientSlice(env, argv[2], batch->valueScratch_);
   batch->Put(key, value);
-  DisposeSliceBuffer(key);
-  DisposeSliceBuffer(value);
 
   NAPI_RETURN_UNDEFINED();
 }
@@ -1752,9 +3260,8 @@ NAPI_METHOD(batch_del) {
   NAPI_ARGV(2);
   NAPI_BATCH_CONTEXT();
 
-  leveldb::Slice key = ToSlice(env, argv[1]);
+  leveldb::Slice key = ToTransientSlice(env, argv[1], batch->keyScratch_);
   batch->Del(key);
-  DisposeSliceBuffer(key);
 
   NAPI_RETURN_UNDEFINED();
 }
@@ -1791,6 +3298,8 @@ struct BatchWriteWorker final : public PriorityWorker {
     napi_delete_reference(env_, contextRef_);
   }
 
+  WorkerKind Kind () override { return kWriteWork; }
+
   void DoExecute () override {
     if (batch_->hasData_) {
       SetStatus(batch_->Write(sync_));
@@ -1830,10 +3339,19 @@ NAPI_INIT() {
   NAPI_EXPORT_FUNCTION(db_close);
   NAPI_EXPORT_FUNCTION(db_put);
   NAPI_EXPORT_FUNCTION(db_get);
+  NAPI_EXPORT_FUNCTION(db_try_get);
+  NAPI_EXPORT_FUNCTION(db_get_many);
   NAPI_EXPORT_FUNCTION(db_del);
   NAPI_EXPORT_FUNCTION(db_approximate_size);
   NAPI_EXPORT_FUNCTION(db_compact_range);
   NAPI_EXPORT_FUNCTION(db_get_property);
+  NAPI_EXPORT_FUNCTION(db_write_stall_state);
+  NAPI_EXPORT_FUNCTION(db_set_write_stall_listener);
+
+  NAPI_EXPORT_FUNCTION(cache_init);
+  NAPI_EXPORT_FUNCTION(cache_usage);
+  NAPI_EXPORT_FUNCTION(write_buffer_manager_init);
+  NAPI_EXPORT_FUNCTION(write_buffer_manager_usage);
 
   NAPI_EXPORT_FUNCTION(destroy_db);
   NAPI_EXPORT_FUNCTION(repair_db);
@@ -1844,6 +3362,7 @@ NAPI_INIT() {
   NAPI_EXPORT_FUNCTION(iterator_next);
 
   NAPI_EXPORT_FUNCTION(batch_do);
+  NAPI_EXPORT_FUNCTION(batch_do_packed);
   NAPI_EXPORT_FUNCTION(batch_init);
   NAPI_EXPORT_FUNCTION(batch_put);
   NAPI_EXPORT_FUNCTION(batch_del);
@@ -0,0 +1,30 @@
+const binding = require('./binding')
+
+// A block cache that several databases can share with the `cache` option.
+function Cache (size, options) {
+  if (!(this instanceof Cache)) {
+    return new Cache(size, options)
+  }
+
+  if (typeof size !== 'number' || size < 0) {
+    throw new Error('Cache() requires a size in bytes')
+  }
+
+  options = options || {}
+
+  if (!Cache.isPolicy(options.policy)) {
+    throw new Error('Cache() requires a `policy` of \'lru\' or \'segmented\'')
+  }
+
+  this.context = binding.cache_init(size, options)
+}
+
+Cache.isPolicy = function (policy) {
+  return policy == null || policy === 'lru' || policy === 'segmented'
+}
+
+Cache.prototype.usage = function () {
+  return binding.cache_usage(this.context)
+}
+
+module.exports = Cache
@@ -25,6 +25,7 @@
 #include "leveldb/status.h"
 #include "leveldb/table.h"
 #include "leveldb/table_builder.h"
+#include "leveldb/write_buffer_manager.h"
 #include "port/port.h"
 #include "table/block.h"
 #include "table/merger.h"
@@ -48,6 +49,60 @@ struct DBImpl::Writer {
   explicit Writer(port::Mutex* mu) : cv(mu) { }
 };
 
+// The key ranges of a compaction beyond the first, which are compacted
+// by work items passed to env_->Schedule() and by the compacting thread,
+// whichever claims them first.  It is deleted by the last of those to let
+// go of it, since work items may only run after the compaction is done.
+struct DBImpl::Subcompaction {
+  struct Range {
+    CompactionState* state;
+    const Slice* begin;
+    const Slice* end;
+    Status status;
+  };
+
+  DBImpl* const db;
+  std::vector<std::string> boundaries;  // Start keys of the ranges
+  std::vector<Slice> keys;              // Slices of boundaries
+  std::vector<Range> ranges;
+
+  // Protected by mu
+  port::Mutex mu;
+  port::CondVar cv;     // Signalled when a claimed range is done
+  size_t next;          // Index of the first range not claimed yet
+  size_t done;          // Number of ranges that are done
+  int refs;             // Work items that have not run, plus the compaction
+
+  explicit Subcompaction(DBImpl* d)
+      : db(d), cv(&mu), next(0), done(0), refs(1) { }
+
+  // Compacts the next unclaimed range, if any.  Returns false if there
+  // was none.  REQUIRES: mu is held.
+  bool RunNext() {
+    if (next >= ranges.size()) {
+      return false;
+    }
+    Range* range = &ranges[next++];
+    mu.Unlock();
+    Status s = db->DoCompactionRange(range->state, range->begin, range->end,
+                                     NULL);
+    mu.Lock();
+    range->status = s;
+    done++;
+    cv.SignalAll();
+    return true;
+  }
+
+  // Drops a reference.  REQUIRES: mu is held; it is released.
+  void Unref() {
+    const bool last = (--refs == 0);
+    mu.Unlock();
+    if (last) {
+      delete this;
+    }
+  }
+};
+
 struct DBImpl::CompactionState {
   Compaction* const compaction;
 
@@ -96,8 +151,19 @@ Options SanitizeOptions(const std::string& dbname,
   result.filter_policy = (src.filter_policy != NULL) ? ipolicy : NULL;
   ClipToRange(&result.max_open_files,    64 + kNumNonTableCacheFiles, 50000);
   ClipToRange(&result.write_buffer_size, 64<<10,                      1<<30);
+  ClipToRange(&result.memtable_bloom_size_ratio, 0.0,                 0.25);
   ClipToRange(&result.max_file_size,     1<<20,                       1<<30);
   ClipToRange(&result.block_size,        1<<10,                       4<<20);
+  ClipToRange(&result.max_background_compactions, 1,                  64);
+  ClipToRange(&result.max_subcompactions, 1,                          64);
+  ClipToRange(&result.max_immutable_memtables, 1,                     16);
+  ClipToRange(&result.l0_compaction_trigger, 1,                       1000);
+  ClipToRange(&result.l0_slowdown_writes_trigger,
+              result.l0_compaction_trigger,                           1000);
+  ClipToRange(&result.l0_stop_writes_trigger,
+              result.l0_slowdown_writes_trigger,                      1000);
+  ClipToRange(&result.max_mem_compact_level, 0,        config::kNumLevels - 1);
+  ClipToRange(&result.level_size_multiplier, 2,                       100);
   if (result.info_log == NULL) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -117,7 +183,8 @@ Options SanitizeOptions(const std::string& dbname,
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
-      internal_filter_policy_(raw_options.filter_policy),
+      internal_filter_policy_(raw_options.filter_policy,
+                              raw_options.prefix_extractor),
       options_(SanitizeOptions(dbname, &internal_comparator_,
                                &internal_filter_policy_, raw_options)),
       owns_info_log_(options_.info_log != raw_options.info_log),
@@ -127,15 +194,29 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       shutting_down_(NULL),
       bg_cv_(&mutex_),
       mem_(NULL),
-      imm_(NULL),
       logfile_(NULL),
       logfile_number_(0),
       log_(NULL),
       seed_(0),
       tmp_batch_(new WriteBatch),
-      bg_compaction_scheduled_(false),
+      write_controller_(options_.delayed_write_rate),
+      write_stall_condition_(kWriteStallNormal),
+      write_stall_cause_(kWriteStallNoCause),
+      bg_compactions_scheduled_(0),
+      bg_compactions_unclaimed_(0),
+      busy_levels_(0),
+      bg_flush_scheduled_(false),
+      imm_compacting_(false),
+      applying_edit_(false),
       manual_compaction_(NULL) {
   has_imm_.Release_Store(NULL);
+  switch_requested_.Release_Store(NULL);
+  // Each compaction may split into ranges that take a thread of their own
+  env_->SetBackgroundThreads(options_.max_background_compactions *
+                             options_.max_subcompactions);
+  if (options_.write_buffer_manager != NULL) {
+    options_.write_buffer_manager->Register(this);
+  }
 
   // Reserve ten files or so for other uses and give the rest to TableCache.
   const int table_cache_size = options_.max_open_files - kNumNonTableCacheFiles;
@@ -146,10 +227,14 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
 }
 
 DBImpl::~DBImpl() {
+  if (options_.write_buffer_manager != NULL) {
+    options_.write_buffer_manager->Unregister(this);
+  }
+
   // Wait for background work to finish
   mutex_.Lock();
   shutting_down_.Release_Store(this);  // Any non-NULL value is ok
-  while (bg_compaction_scheduled_) {
+  while (bg_compactions_scheduled_ > 0 || bg_flush_scheduled_) {
     bg_cv_.Wait();
   }
   mutex_.Unlock();
@@ -160,7 +245,9 @@ DBImpl::~DBImpl() {
 
   delete versions_;
   if (mem_ != NULL) mem_->Unref();
-  if (imm_ != NULL) imm_->Unref();
+  for (size_t i = 0; i < imm_.size(); i++) {
+    imm_[i].mem->Unref();
+  }
   delete tmp_batch_;
   delete log_;
   delete logfile_;
@@ -420,7 +507,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     WriteBatchInternal::SetContents(&batch, record);
 
     if (mem == NULL) {
-      mem = new MemTable(internal_comparator_);
+      mem = NewMemTable();
       mem->Ref();
     }
     status = WriteBatchInternal::InsertInto(&batch, mem);
@@ -438,7 +525,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
       compactions++;
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, NULL);
+      status = WriteLevel0Table(mem, edit, NULL, NULL);
       mem->Unref();
       mem = NULL;
       if (!status.ok()) {
@@ -467,7 +554,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
         mem = NULL;
       } else {
         // mem can be NULL if lognum exists but was empty.
-        mem_ = new MemTable(internal_comparator_);
+        mem_ = NewMemTable();
         mem_->Ref();
       }
     }
@@ -477,7 +564,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     // mem did not get reused; compact it.
     if (status.ok()) {
       *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, NULL);
+      status = WriteLevel0Table(mem, edit, NULL, NULL);
     }
     mem->Unref();
   }
@@ -486,7 +573,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
 }
 
 Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
-                                Version* base) {
+                                Version* base, int* picked_level) {
   mutex_.AssertHeld();
   const uint64_t start_micros = env_->NowMicros();
   FileMetaData meta;
@@ -503,6 +590,13 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     mutex_.Lock();
   }
 
+  // Wait for other threads to apply their edits, so that the level that
+  // is picked below is based on the version that the caller applies this
+  // edit to, while still holding the lock.
+  while (applying_edit_) {
+    bg_cv_.Wait();
+  }
+
   Log(options_.info_log, "Level-0 table #%llu: %lld bytes %s",
       (unsigned long long) meta.number,
       (unsigned long long) meta.file_size,
@@ -518,7 +612,8 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     const Slice min_user_key = meta.smallest.user_key();
     const Slice max_user_key = meta.largest.user_key();
     if (base != NULL) {
-      level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
+      level = versions_->current()->PickLevelForMemTableOutput(
+          min_user_key, max_user_key, busy_levels_);
     }
     edit->AddFile(level, meta.number, meta.file_size,
                   meta.smallest, meta.largest);
@@ -528,36 +623,52 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   stats.micros = env_->NowMicros() - start_micros;
   stats.bytes_written = meta.file_size;
   stats_[level].Add(stats);
+  if (picked_level != NULL) {
+    *picked_level = level;
+  }
   return s;
 }
 
 void DBImpl::CompactMemTable() {
   mutex_.AssertHeld();
-  assert(imm_ != NULL);
+  assert(!imm_.empty());
 
-  // Save the contents of the memtable as a new Table
+  // Save the contents of the oldest memtable as a new Table
+  MemTable* imm = imm_.front().mem;
   VersionEdit edit;
   Version* base = versions_->current();
   base->Ref();
-  Status s = WriteLevel0Table(imm_, &edit, base);
+  int level = 0;
+  Status s = WriteLevel0Table(imm, &edit, base, &level);
   base->Unref();
 
+  // The level of the table was picked among those that no running
+  // compaction writes.  Claim it until the table is in the current
+  // version, so that compactions started meanwhile, which do not see the
+  // table, do not write overlapping files to it.
+  const uint32_t claimed_levels = (level > 0) ? (1u << level) : 0;
+  busy_levels_ |= claimed_levels;
+
   if (s.ok() && shutting_down_.Acquire_Load()) {
     s = Status::IOError("Deleting DB during memtable compaction");
   }
 
   // Replace immutable memtable with the generated Table
   if (s.ok()) {
+    // Earlier logs are no longer needed; the next memtable, if any,
+    // still needs its own.
     edit.SetPrevLogNumber(0);
-    edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
-    s = versions_->LogAndApply(&edit, &mutex_);
+    edit.SetLogNumber(imm_.size() > 1 ? imm_[1].log_number : logfile_number_);
+    s = LogAndApply(&edit);
   }
+  busy_levels_ &= ~claimed_levels;
 
   if (s.ok()) {
     // Commit to the new state
-    imm_->Unref();
-    imm_ = NULL;
-    has_imm_.Release_Store(NULL);
+    imm->Unref();
+    imm_.pop_front();
+    has_imm_.Release_Store(imm_.empty() ? NULL : imm_.back().mem);
+    UpdateWriteBufferUsage();
     DeleteObsoleteFiles();
   } else {
     RecordBackgroundError(s);
@@ -590,6 +701,7 @@ void DBImpl::TEST_CompactRange(int level, const Slice* begin,const Slice* end) {
   ManualCompaction manual;
   manual.level = level;
   manual.done = false;
+  manual.in_progress = false;
   if (begin == NULL) {
     manual.begin = NULL;
   } else {
@@ -612,6 +724,10 @@ void DBImpl::TEST_CompactRange(int level, const Slice* begin,const Slice* end) {
       bg_cv_.Wait();
     }
   }
+  while (manual.in_progress) {
+    // A background thread still refers to it
+    bg_cv_.Wait();
+  }
   if (manual_compaction_ == &manual) {
     // Cancel my manual compaction since we aborted early for some reason.
     manual_compaction_ = NULL;
@@ -624,10 +740,10 @@ Status DBImpl::TEST_CompactMemTable() {
   if (s.ok()) {
     // Wait until the compaction completes
     MutexLock l(&mutex_);
-    while (imm_ != NULL && bg_error_.ok()) {
+    while (!imm_.empty() && bg_error_.ok()) {
       bg_cv_.Wait();
     }
-    if (imm_ != NULL) {
+    if (!imm_.empty()) {
       s = bg_error_;
     }
   }
@@ -642,31 +758,101 @@ void DBImpl::RecordBackgroundError(const Status& s) {
   }
 }
 
+Status DBImpl::LogAndApply(VersionEdit* edit) {
+  mutex_.AssertHeld();
+  while (applying_edit_) {
+    bg_cv_.Wait();
+  }
+  applying_edit_ = true;
+  Status s = versions_->LogAndApply(edit, &mutex_);
+  applying_edit_ = false;
+  bg_cv_.SignalAll();
+  return s;
+}
+
+void DBImpl::MaybeScheduleFlush() {
+  mutex_.AssertHeld();
+  if (bg_flush_scheduled_) {
+    // Already scheduled; it flushes all memtables that are queued
+  } else if (shutting_down_.Acquire_Load()) {
+    // DB is being deleted; no more background work
+  } else if (!bg_error_.ok()) {
+    // Already got an error; no more changes
+  } else if (imm_.empty()) {
+    // No work to be done
+  } else {
+    bg_flush_scheduled_ = true;
+    env_->ScheduleHighPriority(&DBImpl::BGFlushWork, this);
+  }
+}
+
+void DBImpl::BGFlushWork(void* db) {
+  reinterpret_cast<DBImpl*>(db)->BackgroundFlush();
+}
+
+void DBImpl::BackgroundFlush() {
+  MutexLock l(&mutex_);
+  assert(bg_flush_scheduled_);
+  // A memtable that is already being compacted by a compaction thread is
+  // left to it, which schedules another flush when done.
+  while (!imm_.empty() && !imm_compacting_ &&
+         !shutting_down_.Acquire_Load() && bg_error_.ok()) {
+    imm_compacting_ = true;
+    CompactMemTable();
+    imm_compacting_ = false;
+    UpdateWriteStall();
+    bg_cv_.SignalAll();  // Wakeup MakeRoomForWrite() if necessary
+  }
+  bg_flush_scheduled_ = false;
+
+  // The new level-0 files may need to be compacted.
+  MaybeScheduleCompaction();
+  bg_cv_.SignalAll();
+}
+
 void DBImpl::MaybeScheduleCompaction() {
   mutex_.AssertHeld();
-  if (bg_compaction_scheduled_) {
-    // Already scheduled
+  if (bg_compactions_unclaimed_ > 0) {
+    // Already scheduled.  Once it has picked its work, the scheduled
+    // compaction calls us again to schedule any work that is left.
+  } else if (bg_compactions_scheduled_ >=
+             options_.max_background_compactions) {
+    // Enough compactions are running
   } else if (shutting_down_.Acquire_Load()) {
     // DB is being deleted; no more background compactions
   } else if (!bg_error_.ok()) {
     // Already got an error; no more changes
-  } else if (imm_ == NULL &&
-             manual_compaction_ == NULL &&
-             !versions_->NeedsCompaction()) {
+  } else if (!HasCompactionWork()) {
     // No work to be done
   } else {
-    bg_compaction_scheduled_ = true;
+    bg_compactions_scheduled_++;
+    bg_compactions_unclaimed_++;
     env_->Schedule(&DBImpl::BGWork, this);
   }
 }
 
+bool DBImpl::HasCompactionWork() {
+  mutex_.AssertHeld();
+  return ManualCompactionReady() ||
+         versions_->NeedsCompaction(busy_levels_);
+}
+
+bool DBImpl::ManualCompactionReady() {
+  mutex_.AssertHeld();
+  return manual_compaction_ != NULL &&
+         !manual_compaction_->in_progress &&
+         (busy_levels_ & (3u << manual_compaction_->level)) == 0;
+}
+
 void DBImpl::BGWork(void* db) {
   reinterpret_cast<DBImpl*>(db)->BackgroundCall();
 }
 
 void DBImpl::BackgroundCall() {
   MutexLock l(&mutex_);
-  assert(bg_compaction_scheduled_);
+  assert(bg_compactions_scheduled_ > 0);
+  assert(bg_compactions_unclaimed_ > 0);
+  bg_compactions_unclaimed_--;
   if (shutting_down_.Acquire_Load()) {
     // No more background work when shutting down.
   } else if (!bg_error_.ok()) {
@@ -675,27 +861,24 @@ void DBImpl::BackgroundCall() {
     BackgroundCompaction();
   }
 
-  bg_compaction_scheduled_ = false;
+  bg_compactions_scheduled_--;
 
   // Previous compaction may have produced too many files in a level,
   // so reschedule another compaction if needed.
   MaybeScheduleCompaction();
+  UpdateWriteStall();
   bg_cv_.SignalAll();
 }
 
 void DBImpl::BackgroundCompaction() {
   mutex_.AssertHeld();
 
-  if (imm_ != NULL) {
-    CompactMemTable();
-    return;
-  }
-
   Compaction* c;
-  bool is_manual = (manual_compaction_ != NULL);
+  bool is_manual = ManualCompactionReady();
+  ManualCompaction* m = manual_compaction_;
   InternalKey manual_end;
   if (is_manual) {
-    ManualCompaction* m = manual_compaction_;
+    m->in_progress = true;
     c = versions_->CompactRange(m->level, m->begin, m->end);
     m->done = (c == NULL);
     if (c != NULL) {
@@ -708,39 +891,49 @@ void DBImpl::BackgroundCompaction() {
         (m->end ? m->end->DebugString().c_str() : "(end)"),
         (m->done ? "(end)" : manual_end.DebugString().c_str()));
   } else {
-    c = versions_->PickCompaction();
+    c = versions_->PickCompaction(busy_levels_);
   }
 
   Status status;
   if (c == NULL) {
     // Nothing to do
-  } else if (!is_manual && c->IsTrivialMove()) {
-    // Move file to next level
-    assert(c->num_input_files(0) == 1);
-    FileMetaData* f = c->input(0, 0);
-    c->edit()->DeleteFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size,
-                       f->smallest, f->largest);
-    status = versions_->LogAndApply(c->edit(), &mutex_);
-    if (!status.ok()) {
-      RecordBackgroundError(status);
-    }
-    VersionSet::LevelSummaryStorage tmp;
-    Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
-        static_cast<unsigned long long>(f->number),
-        c->level() + 1,
-        static_cast<unsigned long long>(f->file_size),
-        status.ToString().c_str(),
-        versions_->LevelSummary(&tmp));
   } else {
-    CompactionState* compact = new CompactionState(c);
-    status = DoCompactionWork(compact);
-    if (!status.ok()) {
-      RecordBackgroundError(status);
+    // Claim the levels of this compaction, so that compactions that are
+    // started by other threads meanwhile do not touch them.
+    const uint32_t levels = 3u << c->level();
+    busy_levels_ |= levels;
+    MaybeScheduleCompaction();
+
+    if (!is_manual && c->IsTrivialMove()) {
+      // Move file to next level
+      assert(c->num_input_files(0) == 1);
+      FileMetaData* f = c->input(0, 0);
+      c->edit()->DeleteFile(c->level(), f->number);
+      c->edit()->AddFile(c->level() + 1, f->number, f->file_size,
+                         f->smallest, f->largest);
+      status = LogAndApply(c->edit());
+      if (!status.ok()) {
+        RecordBackgroundError(status);
+      }
+      VersionSet::LevelSummaryStorage tmp;
+      Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
+          static_cast<unsigned long long>(f->number),
+          c->level() + 1,
+          static_cast<unsigned long long>(f->file_size),
+          status.ToString().c_str(),
+          versions_->LevelSummary(&tmp));
+    } else {
+      CompactionState* compact = new CompactionState(c);
+      status = DoCompactionWork(compact);
+      if (!status.ok()) {
+        RecordBackgroundError(status);
+      }
+      CleanupCompaction(compact);
+      c->ReleaseInputs();
+      DeleteObsoleteFiles();
     }
-    CleanupCompaction(compact);
-    c->ReleaseInputs();
-    DeleteObsoleteFiles();
+
+    busy_levels_ &= ~levels;
   }
   delete c;
 
@@ -754,7 +947,6 @@ void DBImpl::BackgroundCompaction() {
   }
 
   if (is_manual) {
-    ManualCompaction* m = manual_compaction_;
     if (!status.ok()) {
       m->done = true;
     }
@@ -764,6 +956,7 @@ void DBImpl::BackgroundCompaction() {
       m->tmp_storage = manual_end;
       m->begin = &m->tmp_storage;
     }
+    m->in_progress = false;
     manual_compaction_ = NULL;
   }
 }
@@ -881,7 +1074,7 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
         level + 1,
         out.number, out.file_size, out.smallest, out.largest);
   }
-  return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+  return LogAndApply(compact->compaction->edit());
 }
 
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
@@ -903,11 +1096,124 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = snapshots_.oldest()->number_;
   }
 
+  // Split the compaction into key ranges at the boundaries of its
+  // level+1 inputs, to compact them in parallel.  All entries of a user
+  // key end up in the same range.
+  Compaction* const c = compact->compaction;
+  const int ranges = std::min(options_.max_subcompactions,
+                              c->num_input_files(1));
+  Subcompaction* sub = new Subcompaction(this);
+  for (int i = 1; i < ranges; i++) {
+    const int index = i * c->num_input_files(1) / ranges;
+    const Slice key = c->input(1, index)->smallest.user_key();
+    if (sub->boundaries.empty() ||
+        user_comparator()->Compare(key, Slice(sub->boundaries.back())) > 0) {
+      sub->boundaries.push_back(key.ToString());
+    }
+  }
+  sub->keys.assign(sub->boundaries.begin(), sub->boundaries.end());
+  const std::vector<Slice>& keys = sub->keys;
+  sub->ranges.resize(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    CompactionState* state = new CompactionState(c->NewSubcompaction());
+    state->smallest_snapshot = compact->smallest_snapshot;
+    sub->ranges[i].state = state;
+    sub->ranges[i].begin = &keys[i];
+    sub->ranges[i].end = (i + 1 < keys.size()) ? &keys[i + 1] : NULL;
+  }
+  if (!keys.empty()) {
+    Log(options_.info_log, "Compacting in %d key ranges",
+        static_cast<int>(keys.size() + 1));
+  }
+
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
+  Status status;
+  if (keys.empty()) {
+    status = DoCompactionRange(compact, NULL, NULL, &imm_micros);
+  } else {
+    // Compact the first range on this thread, and the others on the
+    // background threads that are free.  This thread compacts the ranges
+    // that no background thread has claimed once it is done with its own,
+    // so it never waits for work items that are queued up.
+    sub->refs += static_cast<int>(sub->ranges.size());
+    for (size_t i = 0; i < sub->ranges.size(); i++) {
+      env_->Schedule(&DBImpl::SubcompactionWork, sub);
+    }
+    status = DoCompactionRange(compact, NULL, &keys[0], &imm_micros);
+    sub->mu.Lock();
+    while (sub->RunNext()) { }
+    while (sub->done < sub->ranges.size()) {
+      sub->cv.Wait();
+    }
+    sub->mu.Unlock();
+    for (size_t i = 0; i < sub->ranges.size() && status.ok(); i++) {
+      status = sub->ranges[i].status;
+    }
+  }
+
+  CompactionStats stats;
+  stats.micros = env_->NowMicros() - start_micros - imm_micros;
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+      stats.bytes_read += compact->compaction->input(which, i)->file_size;
+    }
+  }
+
+  mutex_.Lock();
+
+  // Gather the outputs of all ranges, in key order
+  for (size_t i = 0; i < sub->ranges.size(); i++) {
+    CompactionState* state = sub->ranges[i].state;
+    compact->outputs.insert(compact->outputs.end(),
+                            state->outputs.begin(), state->outputs.end());
+    compact->total_bytes += state->total_bytes;
+    if (state->builder != NULL) {
+      state->builder->Abandon();
+      delete state->builder;
+    }
+    delete state->outfile;
+    delete state->compaction;
+    delete state;
+  }
+  sub->mu.Lock();
+  sub->Unref();
+
+  for (size_t i = 0; i < compact->outputs.size(); i++) {
+    stats.bytes_written += compact->outputs[i].file_size;
+  }
+  stats_[compact->compaction->level() + 1].Add(stats);
+
+  if (status.ok()) {
+    status = InstallCompactionResults(compact);
+  }
+  if (!status.ok()) {
+    RecordBackgroundError(status);
+  }
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log,
+      "compacted to: %s", versions_->LevelSummary(&tmp));
+  return status;
+}
+
+void DBImpl::SubcompactionWork(void* arg) {
+  Subcompaction* sub = reinterpret_cast<Subcompaction*>(arg);
+  sub->mu.Lock();
+  sub->RunNext();
+  sub->Unref();
+}
+
+Status DBImpl::DoCompactionRange(CompactionState* compact,
+                                 const Slice* begin, const Slice* end,
+                                 int64_t* imm_micros) {
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
-  input->SeekToFirst();
+  if (begin != NULL) {
+    InternalKey start(*begin, kMaxSequenceNumber, kValueTypeForSeek);
+    input->Seek(start.Encode());
+  } else {
+    input->SeekToFirst();
+  }
   Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
@@ -915,18 +1221,26 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
   for (; input->Valid() && !shutting_down_.Acquire_Load(); ) {
     // Prioritize immutable compaction work
-    if (has_imm_.NoBarrier_Load() != NULL) {
+    if (imm_micros != NULL && has_imm_.NoBarrier_Load() != NULL) {
       const uint64_t imm_start = env_->NowMicros();
       mutex_.Lock();
-      if (imm_ != NULL) {
+      if (!imm_.empty() && !imm_compacting_) {
+        imm_compacting_ = true;
         CompactMemTable();
+        imm_compacting_ = false;
+        MaybeScheduleFlush();  // In case the flush thread left it to us
         bg_cv_.SignalAll();  // Wakeup MakeRoomForWrite() if necessary
       }
       mutex_.Unlock();
-      imm_micros += (env_->NowMicros() - imm_start);
+      *imm_micros += (env_->NowMicros() - imm_start);
     }
 
     Slice key = input->key();
+    if (end != NULL && key.size() >= 8 &&
+        user_comparator()->Compare(ExtractUserKey(key), *end) >= 0) {
+      // The rest belongs to another key range
+      break;
+    }
     if (compact->compaction->ShouldStopBefore(key) &&
         compact->builder != NULL) {
       status = FinishCompactionOutputFile(compact, input);
@@ -1017,31 +1331,6 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     status = input->status();
   }
   delete input;
-  input = NULL;
-
-  CompactionStats stats;
-  stats.micros = env_->NowMicros() - start_micros - imm_micros;
-  for (int which = 0; which < 2; which++) {
-    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
-      stats.bytes_read += compact->compaction->input(which, i)->file_size;
-    }
-  }
-  for (size_t i = 0; i < compact->outputs.size(); i++) {
-    stats.bytes_written += compact->outputs[i].file_size;
-  }
-
-  mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
-
-  if (status.ok()) {
-    status = InstallCompactionResults(compact);
-  }
-  if (!status.ok()) {
-    RecordBackgroundError(status);
-  }
-  VersionSet::LevelSummaryStorage tmp;
-  Log(options_.info_log,
-      "compacted to: %s", versions_->LevelSummary(&tmp));
   return status;
 }
 
@@ -1050,14 +1339,16 @@ struct IterState {
   port::Mutex* mu;
   Version* version;
   MemTable* mem;
-  MemTable* imm;
+  std::vector<MemTable*> imms;
 };
 
 static void CleanupIteratorState(void* arg1, void* arg2) {
   IterState* state = reinterpret_cast<IterState*>(arg1);
   state->mu->Lock();
   state->mem->Unref();
-  if (state->imm != NULL) state->imm->Unref();
+  for (size_t i = 0; i < state->imms.size(); i++) {
+    state->imms[i]->Unref();
+  }
   state->version->Unref();
   state->mu->Unlock();
   delete state;
@@ -1075,9 +1366,11 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
   std::vector<Iterator*> list;
   list.push_back(mem_->NewIterator());
   mem_->Ref();
-  if (imm_ != NULL) {
-    list.push_back(imm_->NewIterator());
-    imm_->Ref();
+  for (size_t i = 0; i < imm_.size(); i++) {
+    MemTable* imm = imm_[i].mem;
+    list.push_back(imm->NewIterator());
+    imm->Ref();
+    cleanup->imms.push_back(imm);
   }
   versions_->current()->AddIterators(options, &list);
   Iterator* internal_iter =
@@ -1086,7 +1379,6 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
 
   cleanup->mu = &mutex_;
   cleanup->mem = mem_;
-  cleanup->imm = imm_;
   cleanup->version = versions_->current();
   internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, NULL);
 
@@ -1119,10 +1411,13 @@ Status DBImpl::Get(const ReadOptions& options,
   }
 
   MemTable* mem = mem_;
-  MemTable* imm = imm_;
+  std::vector<MemTable*> imms;  // Newest first
+  for (size_t i = imm_.size(); i > 0; i--) {
+    imms.push_back(imm_[i - 1].mem);
+    imms.back()->Ref();
+  }
   Version* current = versions_->current();
   mem->Ref();
-  if (imm != NULL) imm->Ref();
   current->Ref();
 
   bool have_stat_update = false;
@@ -1131,24 +1426,28 @@ Status DBImpl::Get(const ReadOptions& options,
   // Unlock while reading from files and memtables
   {
     mutex_.Unlock();
-    // First look in the memtable, then in the immutable memtable (if any).
+    // First look in the memtable, then in the immutable memtables (if any)
+    // from newest to oldest.
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != NULL && imm->Get(lkey, value, &s)) {
-      // Done
-    } else {
+    bool done = mem->Get(lkey, value, &s);
+    for (size_t i = 0; !done && i < imms.size(); i++) {
+      done = imms[i]->Get(lkey, value, &s);
+    }
+    if (!done) {
       s = current->Get(options, lkey, value, &stats);
       have_stat_update = true;
     }
     mutex_.Lock();
   }
 
-  if (have_stat_update && current->UpdateStats(stats)) {
+  // An incomplete read is retried by the caller, which counts the seek then.
+  if (have_stat_update && !s.IsIncomplete() && current->UpdateStats(stats)) {
     MaybeScheduleCompaction();
   }
   mem->Unref();
-  if (imm != NULL) imm->Unref();
+  for (size_t i = 0; i < imms.size(); i++) {
+    imms[i]->Unref();
+  }
   current->Unref();
   return s;
 }
@@ -1162,7 +1461,7 @@ Iterator* DBImpl::NewIterator(const ReadOptions& options) {
       (options.snapshot != NULL
        ? reinterpret_cast<const SnapshotImpl*>(options.snapshot)->number_
        : latest_snapshot),
-      seed);
+      seed, options.prefix);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1192,6 +1491,10 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
 }
 
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
+  if (my_batch != NULL && options_.write_buffer_manager != NULL) {
+    options_.write_buffer_manager->MaybeFlush();
+  }
+
   Writer w(&mutex_);
   w.batch = my_batch;
   w.sync = options.sync;
@@ -1212,6 +1515,7 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
   Writer* last_writer = &w;
   if (status.ok() && my_batch != NULL) {  // NULL batch is for compactions
     WriteBatch* updates = BuildBatchGroup(&last_writer);
+    write_controller_.Charge(WriteBatchInternal::ByteSize(updates));
     WriteBatchInternal::SetSequence(updates, last_sequence + 1);
     last_sequence += WriteBatchInternal::Count(updates);
 
@@ -1261,6 +1565,7 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
     writers_.front()->cv.Signal();
   }
 
+  UpdateWriteBufferUsage();
   return status;
 }
 
@@ -1313,12 +1618,29 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
   return result;
 }
 
+MemTable* DBImpl::NewMemTable() const {
+  const size_t filter_bytes = static_cast<size_t>(
+      options_.write_buffer_size * options_.memtable_bloom_size_ratio);
+  return new MemTable(internal_comparator_, filter_bytes);
+}
+
 // REQUIRES: mutex_ is held
 // REQUIRES: this thread is currently at the front of the writer queue
 Status DBImpl::MakeRoomForWrite(bool force) {
   mutex_.AssertHeld();
   assert(!writers_.empty());
   bool allow_delay = !force;
+  if (!force && switch_requested_.Acquire_Load() != NULL &&
+      imm_.size() < static_cast<size_t>(options_.max_immutable_memtables) &&
+      versions_->NumLevelFiles(0) < options_.l0_stop_writes_trigger) {
+    // The write buffer manager asked to free the memory of mem_.  Do so
+    // now, unless it would hold this write up; then a later write will.
+    force = true;
+  }
+  if (allow_delay &&
+      versions_->NumLevelFiles(0) < options_.l0_slowdown_writes_trigger) {
+    write_controller_.Reset();  // Compactions have caught up
+  }
   Status s;
   while (true) {
     if (!bg_error_.ok()) {
@@ -1327,29 +1649,38 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       break;
     } else if (
         allow_delay &&
-        versions_->NumLevelFiles(0) >= config::kL0_SlowdownWritesTrigger) {
+        versions_->NumLevelFiles(0) >= options_.l0_slowdown_writes_trigger) {
       // We are getting close to hitting a hard limit on the number of
       // L0 files.  Rather than delaying a single write by several
-      // seconds when we hit the hard limit, start delaying each
-      // individual write by 1ms to reduce latency variance.  Also,
-      // this delay hands over some CPU to the compaction thread in
-      // case it is sharing the same core as the writer.
-      mutex_.Unlock();
-      env_->SleepForMicroseconds(1000);
+      // seconds when we hit the hard limit, pace individual writes at
+      // a rate that follows the progress of compactions, to reduce
+      // latency variance.  Also, this delay hands over some CPU to the
+      // compaction thread in case it is sharing the same core as the
+      // writer.
+      SetWriteStall(kWriteStallDelayed, kWriteStallLevel0Files);
+      const uint64_t delay = write_controller_.GetDelay(
+          env_->NowMicros(), versions_->NumLevelFiles(0));
       allow_delay = false;  // Do not delay a single write more than once
-      mutex_.Lock();
+      if (delay > 0) {
+        mutex_.Unlock();
+        env_->SleepForMicroseconds(static_cast<int>(delay));
+        mutex_.Lock();
+      }
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
       break;
-    } else if (imm_ != NULL) {
+    } else if (imm_.size() >=
+               static_cast<size_t>(options_.max_immutable_memtables)) {
       // We have filled up the current memtable, but the previous
-      // one is still being compacted, so we wait.
+      // ones are still being compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
+      SetWriteStall(kWriteStallStopped, kWriteStallMemTables);
       bg_cv_.Wait();
-    } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
+    } else if (versions_->NumLevelFiles(0) >= options_.l0_stop_writes_trigger) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
+      SetWriteStall(kWriteStallStopped, kWriteStallLevel0Files);
       bg_cv_.Wait();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
@@ -1362,22 +1693,79 @@ Status DBImpl::MakeRoomForWrite(bool force) {
         versions_->ReuseFileNumber(new_log_number);
         break;
       }
+      ImmutableMemTable imm;
+      imm.mem = mem_;
+      imm.log_number = logfile_number_;
+      imm_.push_back(imm);
+      has_imm_.Release_Store(mem_);
+      switch_requested_.Release_Store(NULL);
       delete log_;
       delete logfile_;
       logfile_ = lfile;
       logfile_number_ = new_log_number;
       log_ = new log::Writer(lfile);
-      imm_ = mem_;
-      has_imm_.Release_Store(imm_);
-      mem_ = new MemTable(internal_comparator_);
+      mem_ = NewMemTable();
       mem_->Ref();
       force = false;   // Do not force another compaction if have room
-      MaybeScheduleCompaction();
+      MaybeScheduleFlush();
+    }
+  }
+  if (s.ok()) {
+    if (write_controller_.delayed()) {
+      SetWriteStall(kWriteStallDelayed, kWriteStallLevel0Files);
+    } else {
+      SetWriteStall(kWriteStallNormal, kWriteStallNoCause);
     }
   }
   return s;
 }
 
+void DBImpl::UpdateWriteBufferUsage() {
+  mutex_.AssertHeld();
+  if (options_.write_buffer_manager != NULL) {
+    size_t immutable_bytes = 0;
+    for (size_t i = 0; i < imm_.size(); i++) {
+      immutable_bytes += imm_[i].mem->ApproximateMemoryUsage();
+    }
+    options_.write_buffer_manager->SetUsage(
+        this, mem_->ApproximateMemoryUsage(), immutable_bytes);
+  }
+}
+
+void DBImpl::UpdateWriteStall() {
+  mutex_.AssertHeld();
+  if (write_stall_condition_ == kWriteStallNormal) {
+    return;
+  }
+  // The condition that a write with a full memtable would meet now
+  const bool mem_full =
+      mem_->ApproximateMemoryUsage() > options_.write_buffer_size;
+  const int level0_files = versions_->NumLevelFiles(0);
+  if (mem_full &&
+      imm_.size() >= static_cast<size_t>(options_.max_immutable_memtables)) {
+    SetWriteStall(kWriteStallStopped, kWriteStallMemTables);
+  } else if (mem_full && level0_files >= options_.l0_stop_writes_trigger) {
+    SetWriteStall(kWriteStallStopped, kWriteStallLevel0Files);
+  } else if (level0_files >= options_.l0_slowdown_writes_trigger) {
+    SetWriteStall(kWriteStallDelayed, kWriteStallLevel0Files);
+  } else {
+    write_controller_.Reset();  // Compactions have caught up
+    SetWriteStall(kWriteStallNormal, kWriteStallNoCause);
+  }
+}
+
+void DBImpl::SetWriteStall(WriteStallCondition condition,
+                           WriteStallCause cause) {
+  mutex_.AssertHeld();
+  if (condition != write_stall_condition_ || cause != write_stall_cause_) {
+    write_stall_condition_ = condition;
+    write_stall_cause_ = cause;
+    if (options_.write_stall_listener != NULL) {
+      options_.write_stall_listener->OnWriteStallChange(condition, cause);
+    }
+  }
+}
+
 bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   value->clear();
 
@@ -1432,8 +1820,8 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
     if (mem_) {
       total_usage += mem_->ApproximateMemoryUsage();
     }
-    if (imm_) {
-      total_usage += imm_->ApproximateMemoryUsage();
+    for (size_t i = 0; i < imm_.size(); i++) {
+      total_usage += imm_[i].mem->ApproximateMemoryUsage();
     }
     char buf[50];
     snprintf(buf, sizeof(buf), "%llu",
@@ -1508,7 +1896,7 @@ Status DB::Open(const Options& options, const std::string& dbname,
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
       impl->log_ = new log::Writer(lfile);
-      impl->mem_ = new MemTable(impl->internal_comparator_);
+      impl->mem_ = impl->NewMemTable();
       impl->mem_->Ref();
     }
   }
@@ -10,6 +10,7 @@
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
+#include "db/write_controller.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "port/port.h"
@@ -66,7 +67,9 @@ class DBImpl : public DB {
 
  private:
   friend class DB;
+  friend class WriteBufferManager;
   struct CompactionState;
+  struct Subcompaction;
   struct Writer;
 
   Iterator* NewInternalIterator(const ReadOptions&,
@@ -86,25 +89,48 @@ class DBImpl : public DB {
   // Delete any unneeded files and stale in-memory entries.
   void DeleteObsoleteFiles();
 
-  // Compact the in-memory write buffer to disk.  Switches to a new
-  // log-file/memtable and writes a new descriptor iff successful.
-  // Errors are recorded in bg_error_.
+  // Compact the oldest immutable memtable to disk.  Drops it and writes
+  // a new descriptor iff successful.  Errors are recorded in bg_error_.
   void CompactMemTable() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status RecoverLogFile(uint64_t log_number, bool last_log, bool* save_manifest,
                         VersionEdit* edit, SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
+  // Writes "mem" to a table and adds it to *edit.  If base is non-NULL,
+  // the table may be pushed to a level > 0 that no running compaction
+  // writes; the level is stored in *level.
+  Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base,
+                          int* level)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Returns a new, empty write buffer with a filter if one is configured.
+  MemTable* NewMemTable() const;
+
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Reports the end or easing of a write stall once background work has
+  // brought it about.  Stalls only start in MakeRoomForWrite().
+  void UpdateWriteStall() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void SetWriteStall(WriteStallCondition condition, WriteStallCause cause)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Tells options_.write_buffer_manager how much memory the memtables use.
+  void UpdateWriteBufferUsage() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   WriteBatch* BuildBatchGroup(Writer** last_writer);
 
   void RecordBackgroundError(const Status& s);
 
+  // Apply *edit to the current version, after waiting for other threads
+  // to finish doing so.
+  Status LogAndApply(VersionEdit* edit) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  void MaybeScheduleFlush() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  static void BGFlushWork(void* db);
+  void BackgroundFlush();
+
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool HasCompactionWork() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool ManualCompactionReady() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   static void BGWork(void* db);
   void BackgroundCall();
   void  BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -113,6 +139,14 @@ class DBImpl : public DB {
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Compact the user keys in [*begin,*end) of the compaction inputs, where
+  // NULL means unbounded.  Flushes imm_ in between if imm_micros is
+  // non-NULL, adding the time spent to *imm_micros.
+  Status DoCompactionRange(CompactionState* compact,
+                           const Slice* begin, const Slice* end,
+                           int64_t* imm_micros);
+  static void SubcompactionWork(void* arg);
+
   Status OpenCompactionOutputFile(CompactionState* compact);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
   Status InstallCompactionResults(CompactionState* compact)
@@ -138,8 +172,20 @@ class DBImpl : public DB {
   port::AtomicPointer shutting_down_;
   port::CondVar bg_cv_;          // Signalled when background work finishes
   MemTable* mem_;
-  MemTable* imm_;                // Memtable being compacted
-  port::AtomicPointer has_imm_;  // So bg thread can detect non-NULL imm_
+
+  // Memtables that are full and wait to be compacted, oldest first, with
+  // the number of the log file that holds their updates.
+  struct ImmutableMemTable {
+    MemTable* mem;
+    uint64_t log_number;
+  };
+  std::deque<ImmutableMemTable> imm_;
+  port::AtomicPointer has_imm_;  // So bg thread can detect non-empty imm_
+
+  // Non-NULL once options_.write_buffer_manager has asked for mem_ to be
+  // switched to a new memtable at the next write.
+  port::AtomicPointer switch_requested_;
+
   WritableFile* logfile_;
   uint64_t logfile_number_;
   log::Writer* log_;
@@ -147,6 +193,9 @@ class DBImpl : public DB {
 
   // Queue of writers.
   std::deque<Writer*> writers_;
+  WriteController write_controller_;  // Paces writes when L0 fills up
+  WriteStallCondition write_stall_condition_;
+  WriteStallCause write_stall_cause_;
   WriteBatch* tmp_batch_;
 
   SnapshotList snapshots_;
@@ -155,13 +204,29 @@ class DBImpl : public DB {
   // part of ongoing compactions.
   std::set<uint64_t> pending_outputs_;
 
-  // Has a background compaction been scheduled or is running?
-  bool bg_compaction_scheduled_;
+  // Number of background compactions that are scheduled or running, and
+  // the number of those that have not yet picked their work.
+  int bg_compactions_scheduled_;
+  int bg_compactions_unclaimed_;
+
+  // Bit mask of the levels that running compactions read or write.
+  uint32_t busy_levels_;
+
+  // Has a memtable compaction been scheduled or is running?
+  bool bg_flush_scheduled_;
+
+  // Is the oldest memtable in imm_ being compacted?
+  bool imm_compacting_;
+
+  // Is a thread applying a version edit?  VersionSet::LogAndApply()
+  // must not be called concurrently.
+  bool applying_edit_;
 
   // Information for a manual compaction
   struct ManualCompaction {
     int level;
     bool done;
+    bool in_progress;           // Is a background thread compacting it?
     const InternalKey* begin;   // NULL means beginning of key range
     const InternalKey* end;     // NULL means end of key range
     InternalKey tmp_storage;    // Used to keep track of compaction progress
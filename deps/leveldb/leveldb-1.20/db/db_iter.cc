@@ -49,11 +49,12 @@ class DBIter: public Iterator {
   };
 
   DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+         uint32_t seed, const Slice& prefix)
       : db_(db),
         user_comparator_(cmp),
         iter_(iter),
         sequence_(s),
+        prefix_(prefix.data(), prefix.size()),
         direction_(kForward),
         valid_(false),
         rnd_(seed),
@@ -90,6 +91,10 @@ class DBIter: public Iterator {
   void FindPrevUserEntry();
   bool ParseKey(ParsedInternalKey* key);
 
+  inline bool InPrefix(const Slice& user_key) const {
+    return prefix_.empty() || user_key.starts_with(prefix_);
+  }
+
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
   }
@@ -112,6 +117,7 @@ class DBIter: public Iterator {
   const Comparator* const user_comparator_;
   Iterator* const iter_;
   SequenceNumber const sequence_;
+  const std::string prefix_;  // Bounds the keys if non-empty
 
   Status status_;
   std::string saved_key_;     // == current key when direction_==kReverse
@@ -176,7 +182,11 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   assert(direction_ == kForward);
   do {
     ParsedInternalKey ikey;
-    if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+    const bool parsed = ParseKey(&ikey);
+    if (parsed && !InPrefix(ikey.user_key)) {
+      break;  // Past the keys with the prefix
+    }
+    if (parsed && ikey.sequence <= sequence_) {
       switch (ikey.type) {
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
@@ -236,7 +246,11 @@ void DBIter::FindPrevUserEntry() {
   if (iter_->Valid()) {
     do {
       ParsedInternalKey ikey;
-      if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+      const bool parsed = ParseKey(&ikey);
+      if (parsed && !InPrefix(ikey.user_key)) {
+        break;  // Before the keys with the prefix
+      }
+      if (parsed && ikey.sequence <= sequence_) {
         if ((value_type != kTypeDeletion) &&
             user_comparator_->Compare(ikey.user_key, saved_key_) < 0) {
           // We encountered a non-deleted value in entries for previous keys,
@@ -275,8 +289,12 @@ void DBIter::Seek(const Slice& target) {
   direction_ = kForward;
   ClearSavedValue();
   saved_key_.clear();
+  Slice start = target;
+  if (!prefix_.empty() && user_comparator_->Compare(target, prefix_) < 0) {
+    start = prefix_;
+  }
   AppendInternalKey(
-      &saved_key_, ParsedInternalKey(target, sequence_, kValueTypeForSeek));
+      &saved_key_, ParsedInternalKey(start, sequence_, kValueTypeForSeek));
   iter_->Seek(saved_key_);
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
@@ -286,6 +304,10 @@ void DBIter::Seek(const Slice& target) {
 }
 
 void DBIter::SeekToFirst() {
+  if (!prefix_.empty()) {
+    Seek(prefix_);
+    return;
+  }
   direction_ = kForward;
   ClearSavedValue();
   iter_->SeekToFirst();
@@ -296,10 +318,39 @@ void DBIter::SeekToFirst() {
   }
 }
 
+// Sets *limit to the shortest key that is greater than all keys that start
+// with "prefix", and returns false if there is no such key.
+static bool PrefixSuccessor(const std::string& prefix, std::string* limit) {
+  *limit = prefix;
+  while (!limit->empty()) {
+    const uint8_t byte = static_cast<uint8_t>((*limit)[limit->size() - 1]);
+    if (byte != 0xff) {
+      (*limit)[limit->size() - 1] = byte + 1;
+      return true;
+    }
+    limit->resize(limit->size() - 1);
+  }
+  return false;
+}
+
 void DBIter::SeekToLast() {
   direction_ = kReverse;
   ClearSavedValue();
-  iter_->SeekToLast();
+  std::string limit;
+  if (!prefix_.empty() && PrefixSuccessor(prefix_, &limit)) {
+    // Position at the last entry before the keys past the prefix
+    saved_key_.clear();
+    AppendInternalKey(&saved_key_, ParsedInternalKey(limit, kMaxSequenceNumber,
+                                                     kValueTypeForSeek));
+    iter_->Seek(saved_key_);
+    if (iter_->Valid()) {
+      iter_->Prev();
+    } else {
+      iter_->SeekToLast();
+    }
+  } else {
+    iter_->SeekToLast();
+  }
   FindPrevUserEntry();
 }
 
@@ -310,8 +361,10 @@ Iterator* NewDBIterator(
     const Comparator* user_key_comparator,
     Iterator* internal_iter,
     SequenceNumber sequence,
-    uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+    uint32_t seed,
+    const Slice& prefix) {
+  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed,
+                    prefix);
 }
 
 }  // namespace leveldb
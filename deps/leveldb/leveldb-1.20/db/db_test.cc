@@ -6,11 +6,14 @@
 #include "leveldb/filter_policy.h"
 #include "db/db_impl.h"
 #include "db/filename.h"
+#include "db/memtable.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
+#include "leveldb/prefix_extractor.h"
 #include "leveldb/table.h"
+#include "leveldb/write_buffer_manager.h"
 #include "util/hash.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -78,12 +81,17 @@ class SpecialEnv : public EnvWrapper {
   bool count_random_reads_;
   AtomicCounter random_read_counter_;
 
+  // Return random reads in the caller's buffer, as reads without mmap do,
+  // so that the blocks read can be cached.
+  bool copy_random_reads_;
+
   explicit SpecialEnv(Env* base) : EnvWrapper(base) {
     delay_data_sync_.Release_Store(NULL);
     data_sync_error_.Release_Store(NULL);
     no_space_.Release_Store(NULL);
     non_writable_.Release_Store(NULL);
     count_random_reads_ = false;
+    copy_random_reads_ = false;
     manifest_sync_error_.Release_Store(NULL);
     manifest_write_error_.Release_Store(NULL);
   }
@@ -166,21 +174,28 @@ class SpecialEnv : public EnvWrapper {
      private:
       RandomAccessFile* target_;
       AtomicCounter* counter_;
+      bool copy_;
      public:
-      CountingFile(RandomAccessFile* target, AtomicCounter* counter)
-          : target_(target), counter_(counter) {
+      CountingFile(RandomAccessFile* target, AtomicCounter* counter,
+                   bool copy)
+          : target_(target), counter_(counter), copy_(copy) {
       }
       virtual ~CountingFile() { delete target_; }
       virtual Status Read(uint64_t offset, size_t n, Slice* result,
                           char* scratch) const {
         counter_->Increment();
-        return target_->Read(offset, n, result, scratch);
+        Status s = target_->Read(offset, n, result, scratch);
+        if (s.ok() && copy_ && result->data() != scratch) {
+          memcpy(scratch, result->data(), result->size());
+          *result = Slice(scratch, result->size());
+        }
+        return s;
       }
     };
 
     Status s = target()->NewRandomAccessFile(f, r);
-    if (s.ok() && count_random_reads_) {
-      *r = new CountingFile(*r, &random_read_counter_);
+    if (s.ok() && (count_random_reads_ || copy_random_reads_)) {
+      *r = new CountingFile(*r, &random_read_counter_, copy_random_reads_);
     }
     return s;
   }
@@ -189,6 +204,7 @@ class SpecialEnv : public EnvWrapper {
 class DBTest {
  private:
   const FilterPolicy* filter_policy_;
+  const FilterPolicy* blocked_filter_policy_;
 
   // Sequence of option configurations to try
   enum OptionConfig {
@@ -196,6 +212,11 @@ class DBTest {
     kReuse,
     kFilter,
     kUncompressed,
+    kConcurrentCompactions,
+    kDataBlockHashIndex,
+    kBlockedFilter,
+    kWholeTableFilter,
+    kMemTableFilter,
     kEnd
   };
   int option_config_;
@@ -210,6 +231,7 @@ class DBTest {
   DBTest() : option_config_(kDefault),
              env_(new SpecialEnv(Env::Default())) {
     filter_policy_ = NewBloomFilterPolicy(10);
+    blocked_filter_policy_ = NewBlockedBloomFilterPolicy(10);
     dbname_ = test::TmpDir() + "/db_test";
     DestroyDB(dbname_, Options());
     db_ = NULL;
@@ -221,6 +243,7 @@ class DBTest {
     DestroyDB(dbname_, Options());
     delete env_;
     delete filter_policy_;
+    delete blocked_filter_policy_;
   }
 
   // Switch to a fresh database with the next option configuration to
@@ -249,6 +272,24 @@ class DBTest {
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kConcurrentCompactions:
+        options.max_background_compactions = 4;
+        options.max_subcompactions = 4;
+        options.max_immutable_memtables = 3;
+        break;
+      case kDataBlockHashIndex:
+        options.data_block_hash_index = true;
+        break;
+      case kBlockedFilter:
+        options.filter_policy = blocked_filter_policy_;
+        break;
+      case kWholeTableFilter:
+        options.filter_policy = filter_policy_;
+        options.whole_table_filter = true;
+        break;
+      case kMemTableFilter:
+        options.memtable_bloom_size_ratio = 0.1;
+        break;
       default:
         break;
     }
@@ -563,6 +604,30 @@ TEST(DBTest, GetFromVersions) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, GetWithoutIO) {
+  do {
+    ReadOptions options;
+    options.no_io = true;
+    std::string value;
+
+    ASSERT_OK(Put("foo", "v1"));
+    ASSERT_OK(db_->Get(options, "foo", &value));
+    ASSERT_EQ("v1", value);
+
+    dbfull()->TEST_CompactMemTable();
+    Reopen();
+    ASSERT_TRUE(db_->Get(options, "foo", &value).IsIncomplete());
+    ASSERT_TRUE(db_->Get(options, "zzz", &value).IsNotFound());
+
+    // Blocks of memory-mapped tables are not cached, so those stay
+    // incomplete even after the table has been opened.
+    ASSERT_EQ("v1", Get("foo"));
+    Status s = db_->Get(options, "foo", &value);
+    ASSERT_TRUE(s.ok() || s.IsIncomplete());
+    if (s.ok()) ASSERT_EQ("v1", value);
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, GetMemUsage) {
   do {
     ASSERT_OK(Put("foo", "v1"));
@@ -1002,6 +1067,240 @@ TEST(DBTest, CompactionsGenerateMultipleFiles) {
   }
 }
 
+TEST(DBTest, Subcompactions) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000000;        // Large write buffer
+  options.max_subcompactions = 4;
+  Reopen(&options);
+
+  Random rnd(301);
+
+  // Write 8MB (80 values, each 100K) to several level-1 files
+  std::vector<std::string> values;
+  for (int i = 0; i < 80; i++) {
+    values.push_back(RandomString(&rnd, 100000));
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  Reopen(&options);
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  ASSERT_GT(NumTableFilesAtLevel(1), 1);
+
+  // Overwrite some of them and delete others, so that the next
+  // compaction has several level-1 inputs and is split into ranges
+  for (int i = 0; i < 80; i += 2) {
+    if (i % 4 == 0) {
+      values[i] = RandomString(&rnd, 100000);
+      ASSERT_OK(Put(Key(i), values[i]));
+    } else {
+      values[i] = "NOT_FOUND";
+      ASSERT_OK(Delete(Key(i)));
+    }
+  }
+  Reopen(&options);
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+
+  ASSERT_EQ(NumTableFilesAtLevel(0), 0);
+  ASSERT_GT(NumTableFilesAtLevel(1), 1);
+  for (int i = 0; i < 80; i++) {
+    ASSERT_EQ(Get(Key(i)), values[i]);
+  }
+}
+
+TEST(DBTest, ImmutableMemTables) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.write_buffer_size = 100000;
+  options.max_immutable_memtables = 3;
+  Reopen(&options);
+
+  Random rnd(301);
+
+  // Fill several memtables while level-0 tables cannot be written.  The
+  // writes do not stall, since the full memtables are queued.
+  env_->delay_data_sync_.Release_Store(env_);
+  std::vector<std::string> values;
+  for (int i = 0; i < 25; i++) {
+    values.push_back(RandomString(&rnd, 10000));
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  ASSERT_OK(Put(Key(3), "v3"));
+  values[3] = "v3";
+  ASSERT_OK(Delete(Key(4)));
+  values[4] = "NOT_FOUND";
+  for (int i = 0; i < 25; i++) {
+    ASSERT_EQ(Get(Key(i)), values[i]);
+  }
+  env_->delay_data_sync_.Release_Store(NULL);
+
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_GT(NumTableFilesAtLevel(0) + NumTableFilesAtLevel(1) +
+            NumTableFilesAtLevel(2), 1);
+  for (int i = 0; i < 25; i++) {
+    ASSERT_EQ(Get(Key(i)), values[i]);
+  }
+  Reopen(&options);
+  for (int i = 0; i < 25; i++) {
+    ASSERT_EQ(Get(Key(i)), values[i]);
+  }
+}
+
+namespace {
+class RecordingStallListener : public WriteStallListener {
+ public:
+  port::Mutex mu;
+  std::vector<std::pair<WriteStallCondition, WriteStallCause> > events;
+
+  virtual void OnWriteStallChange(WriteStallCondition condition,
+                                  WriteStallCause cause) {
+    MutexLock l(&mu);
+    events.push_back(std::make_pair(condition, cause));
+  }
+
+  bool Saw(WriteStallCondition condition, WriteStallCause cause) {
+    MutexLock l(&mu);
+    for (size_t i = 0; i < events.size(); i++) {
+      if (events[i].first == condition && events[i].second == cause) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+struct StallWriterState {
+  DB* db;
+  port::AtomicPointer done;
+};
+
+static void StallWriterBody(void* arg) {
+  StallWriterState* state = reinterpret_cast<StallWriterState*>(arg);
+  for (int i = 0; i < 30; i++) {
+    state->db->Put(WriteOptions(), Key(i), std::string(10000, 'x'));
+  }
+  state->done.Release_Store(state);
+}
+}  // namespace
+
+TEST(DBTest, WriteStallListener) {
+  RecordingStallListener listener;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.write_buffer_size = 100000;
+  options.max_immutable_memtables = 1;
+  options.write_stall_listener = &listener;
+  Reopen(&options);
+
+  // Fill more memtables than can be queued while level-0 tables cannot
+  // be written, so that the writer stops.
+  env_->delay_data_sync_.Release_Store(env_);
+  StallWriterState state;
+  state.db = db_;
+  state.done.Release_Store(NULL);
+  env_->StartThread(StallWriterBody, &state);
+  for (int i = 0; i < 100; i++) {
+    if (listener.Saw(kWriteStallStopped, kWriteStallMemTables)) break;
+    DelayMilliseconds(100);
+  }
+  ASSERT_TRUE(listener.Saw(kWriteStallStopped, kWriteStallMemTables));
+  ASSERT_TRUE(state.done.Acquire_Load() == NULL);
+
+  env_->delay_data_sync_.Release_Store(NULL);
+  while (state.done.Acquire_Load() == NULL) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_OK(Put("foo", "v1"));
+
+  MutexLock l(&listener.mu);
+  ASSERT_EQ(kWriteStallNormal, listener.events.back().first);
+  ASSERT_EQ(kWriteStallNoCause, listener.events.back().second);
+}
+
+static void WaitForRelease(void* arg) {
+  port::AtomicPointer* blocked = reinterpret_cast<port::AtomicPointer*>(arg);
+  while (blocked->Acquire_Load() != NULL) {
+    DelayMilliseconds(10);
+  }
+}
+
+TEST(DBTest, WriteStallEndsWithCompaction) {
+  RecordingStallListener listener;
+  Options options = CurrentOptions();
+  options.write_stall_listener = &listener;
+  options.max_mem_compact_level = 0;
+  options.l0_compaction_trigger = 2;
+  options.l0_slowdown_writes_trigger = 2;
+  options.delayed_write_rate = 1 << 30;  // Delay writes, but not by much
+  Reopen(&options);
+
+  // Hold compactions back while level-0 fills up
+  port::AtomicPointer blocked;
+  blocked.Release_Store(&blocked);
+  for (int i = 0; i < 16; i++) {
+    env_->Schedule(&WaitForRelease, &blocked);
+  }
+  ASSERT_OK(Put("a", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("a", "v2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(2, NumTableFilesAtLevel(0));
+  ASSERT_OK(Put("b", "v1"));
+  ASSERT_TRUE(listener.Saw(kWriteStallDelayed, kWriteStallLevel0Files));
+
+  // The compaction reports the end of the stall without another write
+  blocked.Release_Store(NULL);
+  for (int i = 0; i < 100; i++) {
+    if (listener.Saw(kWriteStallNormal, kWriteStallNoCause)) break;
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  MutexLock l(&listener.mu);
+  ASSERT_EQ(kWriteStallNormal, listener.events.back().first);
+  ASSERT_EQ(kWriteStallNoCause, listener.events.back().second);
+}
+
+TEST(DBTest, SharedWriteBufferManager) {
+  WriteBufferManager manager(200000);
+  Options options = CurrentOptions();
+  options.write_buffer_size = 10000000;  // Only the manager flushes
+  options.write_buffer_manager = &manager;
+  Reopen(&options);
+
+  std::string other_dbname = test::TmpDir() + "/db_test_other";
+  DestroyDB(other_dbname, Options());
+  Options other_options = options;
+  other_options.create_if_missing = true;
+  DB* other = NULL;
+  ASSERT_OK(DB::Open(other_options, other_dbname, &other));
+
+  // Stay below the budget
+  for (int i = 0; i < 15; i++) {
+    ASSERT_OK(Put(Key(i), std::string(10000, 'x')));
+  }
+  ASSERT_GT(manager.memory_usage(), 150000);
+  ASSERT_EQ(0, TotalTableFiles());
+
+  // Writes to the other DB ask this one to flush its larger memtable,
+  // which it does at its next write
+  for (int i = 0; i < 5; i++) {
+    ASSERT_OK(other->Put(WriteOptions(), Key(i), std::string(10000, 'y')));
+  }
+  ASSERT_EQ(0, TotalTableFiles());
+  ASSERT_OK(Put("next", "v"));
+  for (int i = 0; i < 100 && TotalTableFiles() == 0; i++) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ(1, TotalTableFiles());
+  ASSERT_LT(manager.memory_usage(), 100000);
+  for (int i = 0; i < 15; i++) {
+    ASSERT_EQ(std::string(10000, 'x'), Get(Key(i)));
+  }
+
+  delete other;
+  DestroyDB(other_dbname, Options());
+  Close();
+  ASSERT_EQ(0, manager.memory_usage());
+}
+
 TEST(DBTest, RepeatedWritesToSameKey) {
   Options options = CurrentOptions();
   options.env = env_;
@@ -1394,6 +1693,72 @@ TEST(DBTest, L0_CompactionBug_Issue44_b) {
   ASSERT_EQ("(->)(c->cv)", Contents());
 }
 
+TEST(DBTest, L0TriggerOptions) {
+  Options options = CurrentOptions();
+  options.l0_compaction_trigger = 2;
+  options.max_mem_compact_level = 0;
+  Reopen(&options);
+
+  // Overlapping files stay in level-0 until the trigger is reached
+  ASSERT_OK(Put("a", "v1"));
+  ASSERT_OK(Put("z", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("1", FilesPerLevel());
+  ASSERT_OK(Put("a", "v2"));
+  ASSERT_OK(Put("z", "v2"));
+  dbfull()->TEST_CompactMemTable();
+  DelayMilliseconds(1000);  // Wait for compaction to finish
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  ASSERT_EQ("v2", Get("a"));
+  ASSERT_EQ("v2", Get("z"));
+}
+
+TEST(DBTest, MaxMemCompactLevelOption) {
+  Options options = CurrentOptions();
+  options.max_mem_compact_level = 4;
+  Reopen(&options);
+
+  ASSERT_OK(Put("foo", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("0,0,0,0,1", FilesPerLevel());
+  ASSERT_EQ("v1", Get("foo"));
+}
+
+TEST(DBTest, DynamicLevelSizes) {
+  Random rnd(301);
+  int files_at_level2[2];
+  for (int dynamic = 0; dynamic < 2; dynamic++) {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.write_buffer_size = 100000000;      // Large write buffer
+    options.level_size_multiplier = 2;          // Level-2 holds 20MB
+    options.dynamic_level_sizes = (dynamic != 0);
+    DestroyAndReopen(&options);
+
+    // Move 12MB to level-3
+    for (int i = 0; i < 120; i++) {
+      ASSERT_OK(Put(Key(i), RandomString(&rnd, 100000)));
+    }
+    Reopen(&options);
+    for (int level = 0; level < 3; level++) {
+      dbfull()->TEST_CompactRange(level, NULL, NULL);
+    }
+    ASSERT_EQ(0, NumTableFilesAtLevel(2));
+
+    // Move another 12MB to level-2, which fits its fixed target, but not
+    // the 10MB that dynamic sizing allows for a level-3 of 12MB.
+    for (int i = 1000; i < 1120; i++) {
+      ASSERT_OK(Put(Key(i), RandomString(&rnd, 100000)));
+    }
+    Reopen(&options);
+    dbfull()->TEST_CompactRange(0, NULL, NULL);
+    dbfull()->TEST_CompactRange(1, NULL, NULL);
+    DelayMilliseconds(1000);  // Wait for compaction to finish
+    files_at_level2[dynamic] = NumTableFilesAtLevel(2);
+  }
+  ASSERT_LT(files_at_level2[1], files_at_level2[0]);
+}
+
 TEST(DBTest, ComparatorCheck) {
   class NewComparator : public Comparator {
    public:
@@ -1755,6 +2120,410 @@ TEST(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST(DBTest, BlockedBloomFilter) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBlockedBloomFilterPolicy(10);
+  Reopen(&options);
+
+  // Populate multiple layers
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
+
+  // Lookup present keys.  Should rarely read from small sstable.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  int reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d present => %d reads\n", N, reads);
+  ASSERT_GE(reads, N);
+  ASSERT_LE(reads, N + 2*N/100);
+
+  // Lookup present keys.  Should rarely read from either sstable.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d missing => %d reads\n", N, reads);
+  ASSERT_LE(reads, 3*N/100);
+
+  env_->delay_data_sync_.Release_Store(NULL);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST(DBTest, WholeTableFilter) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.whole_table_filter = true;
+  Reopen(&options);
+
+  // Populate multiple layers
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
+
+  // Lookup present keys.  Should rarely read from small sstable.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  int reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d present => %d reads\n", N, reads);
+  ASSERT_GE(reads, N);
+  ASSERT_LE(reads, N + 2*N/100);
+
+  // Lookup present keys.  Should rarely read from either sstable.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d missing => %d reads\n", N, reads);
+  ASSERT_LE(reads, 3*N/100);
+
+  env_->delay_data_sync_.Release_Store(NULL);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST(DBTest, CacheIndexAndFilterBlocks) {
+  env_->copy_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(1 << 20);
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.cache_index_and_filter_blocks = true;
+  options.max_mem_compact_level = 0;  // Keep tables in level 0
+  Reopen(&options);
+
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(1, NumTableFilesAtLevel(0));
+
+  // Index and filter blocks are in the cache once the table is open
+  ASSERT_EQ(Key(7), Get(Key(7)));
+  ASSERT_GT(options.block_cache->TotalCharge(), 0);
+
+  // Evicted blocks are read again
+  options.block_cache->Prune();
+  ASSERT_EQ(0, options.block_cache->TotalCharge());
+  env_->random_read_counter_.Reset();
+  ASSERT_EQ("NOT_FOUND", Get(Key(7) + ".missing"));
+  ASSERT_GE(env_->random_read_counter_.Read(), 1);
+  ASSERT_EQ(Key(8), Get(Key(8)));
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) count++;
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(1000, count);
+  delete iter;
+
+  // Pinned blocks of level-0 tables are not evicted
+  options.pin_l0_index_and_filter_blocks = true;
+  Reopen(&options);
+  ASSERT_EQ(Key(7), Get(Key(7)));
+  options.block_cache->Prune();
+  ASSERT_GT(options.block_cache->TotalCharge(), 0);
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  ASSERT_LE(env_->random_read_counter_.Read(), 3);
+
+  env_->copy_random_reads_ = false;
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST(DBTest, PartitionedIndexAndFilters) {
+  env_->copy_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(1 << 20);
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.partition_index_and_filters = true;
+  options.block_size = 256;  // Many partitions
+  options.compression = kNoCompression;
+  Reopen(&options);
+
+  const int N = 2000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), std::string(100, 'v')));
+  }
+  Compact("a", "z");
+  ASSERT_EQ(1, TotalTableFiles());
+
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) count++;
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(N, count);
+  iter->Seek(Key(N / 2));
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ(Key(N / 2), iter->key().ToString());
+  delete iter;
+  ASSERT_GT(Size(Key(0), Key(N / 2)), 0);
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
+
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(std::string(100, 'v'), Get(Key(i)));
+  }
+
+  // Index and filter partitions are read once, and filters keep missing
+  // keys from reading data blocks
+  options.block_cache->Prune();
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  int reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d missing => %d reads\n", N, reads);
+  ASSERT_LE(reads, N/20);
+
+  env_->delay_data_sync_.Release_Store(NULL);
+  env_->copy_random_reads_ = false;
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST(DBTest, PrefixIterator) {
+  env_->copy_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(1 << 20);
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.prefix_extractor = NewDelimitedPrefixExtractor('/', 1);
+  Reopen(&options);
+
+  // Tables whose key ranges span "b/" without holding keys with it
+  ASSERT_OK(Put("a/1", "v1"));
+  ASSERT_OK(Put("c/1", "v1"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("a/2", "v2"));
+  ASSERT_OK(Put("d/1", "v2"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(2, TotalTableFiles());
+
+  ReadOptions ropts;
+  ropts.prefix = "b/";
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) { }
+  delete iter;
+
+  // The filters rule both tables out, so no data blocks are read
+  options.block_cache->Prune();
+  env_->random_read_counter_.Reset();
+  iter = db_->NewIterator(ropts);
+  iter->SeekToFirst();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  iter->SeekToLast();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  delete iter;
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  // Keys around the prefix in tables and the memtable
+  ASSERT_OK(Put("b", "vb"));
+  ASSERT_OK(Put("b/1", "v1"));
+  ASSERT_OK(Put("b/3", "v3"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(Put("b/2", "v2"));
+  ASSERT_OK(Put("bb", "vbb"));
+
+  iter = db_->NewIterator(ropts);
+  iter->SeekToFirst();
+  ASSERT_EQ(IterStatus(iter), "b/1->v1");
+  iter->Next();
+  ASSERT_EQ(IterStatus(iter), "b/2->v2");
+  iter->Next();
+  ASSERT_EQ(IterStatus(iter), "b/3->v3");
+  iter->Next();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+  iter->SeekToLast();
+  ASSERT_EQ(IterStatus(iter), "b/3->v3");
+  iter->Prev();
+  ASSERT_EQ(IterStatus(iter), "b/2->v2");
+  iter->Prev();
+  ASSERT_EQ(IterStatus(iter), "b/1->v1");
+  iter->Prev();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+  iter->Seek("a");
+  ASSERT_EQ(IterStatus(iter), "b/1->v1");
+  iter->Seek("b/2");
+  ASSERT_EQ(IterStatus(iter), "b/2->v2");
+  iter->Seek("c");
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  delete iter;
+
+  // Deleting the keys leaves no entries with the prefix
+  ASSERT_OK(Delete("b/1"));
+  ASSERT_OK(Delete("b/2"));
+  ASSERT_OK(Delete("b/3"));
+  iter = db_->NewIterator(ropts);
+  iter->SeekToFirst();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  iter->SeekToLast();
+  ASSERT_EQ(IterStatus(iter), "(invalid)");
+  delete iter;
+
+  env_->copy_random_reads_ = false;
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+  delete options.prefix_extractor;
+}
+
+static std::string PrefixScan(DB* db, const Slice& prefix) {
+  ReadOptions ropts;
+  ropts.prefix = prefix;
+  Iterator* iter = db->NewIterator(ropts);
+  std::string result;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (!result.empty()) result += ",";
+    result += iter->key().ToString();
+  }
+  delete iter;
+  return result;
+}
+
+TEST(DBTest, PrefixIteratorInexactPrefix) {
+  Options options = CurrentOptions();
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.prefix_extractor = NewDelimitedPrefixExtractor('/', 2);
+  Reopen(&options);
+
+  // The filters hold "tenant/42/" and whole keys, but neither the shorter
+  // nor the longer prefixes below
+  ASSERT_OK(Put("tenant/42/users/1", "v1"));
+  ASSERT_OK(Put("tenant/42/x", "v2"));
+  dbfull()->TEST_CompactMemTable();
+  dbfull()->TEST_CompactRange(0, NULL, NULL);
+  ASSERT_OK(Put("tenant/41/a", "v3"));
+  ASSERT_OK(Put("tenant/43/b", "v4"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(2, TotalTableFiles());
+
+  ASSERT_EQ("tenant/41/a,tenant/42/users/1,tenant/42/x,tenant/43/b",
+            PrefixScan(db_, "tenant/4"));
+  ASSERT_EQ("tenant/42/users/1", PrefixScan(db_, "tenant/42/us"));
+  ASSERT_EQ("tenant/42/users/1,tenant/42/x", PrefixScan(db_, "tenant/42/"));
+  ASSERT_EQ("", PrefixScan(db_, "tenant/44/"));
+
+  Close();
+  delete options.filter_policy;
+  delete options.prefix_extractor;
+}
+
+namespace {
+class CountingComparator : public Comparator {
+ public:
+  mutable int count;
+
+  CountingComparator() : count(0) { }
+  virtual const char* Name() const { return BytewiseComparator()->Name(); }
+  virtual int Compare(const Slice& a, const Slice& b) const {
+    count++;
+    return BytewiseComparator()->Compare(a, b);
+  }
+  virtual void FindShortestSeparator(std::string* start,
+                                     const Slice& limit) const {
+    BytewiseComparator()->FindShortestSeparator(start, limit);
+  }
+  virtual void FindShortSuccessor(std::string* key) const {
+    BytewiseComparator()->FindShortSuccessor(key);
+  }
+};
+}
+
+TEST(DBTest, MemTableFilter) {
+  CountingComparator counting;
+  InternalKeyComparator cmp(&counting);
+  MemTable* mem = new MemTable(cmp, 4096);
+  mem->Ref();
+  for (int i = 0; i < 100; i++) {
+    mem->Add(i + 1, kTypeValue, Key(i), "v" + NumberToString(i));
+  }
+  mem->Add(101, kTypeDeletion, Key(50), "");
+
+  std::string value;
+  Status s;
+  for (int i = 0; i < 100; i++) {
+    s = Status::OK();
+    ASSERT_TRUE(mem->Get(LookupKey(Key(i), 200), &value, &s));
+    if (i == 50) {
+      ASSERT_TRUE(s.IsNotFound());
+    } else {
+      ASSERT_EQ("v" + NumberToString(i), value);
+    }
+  }
+  // Older snapshots still find the deleted value
+  s = Status::OK();
+  ASSERT_TRUE(mem->Get(LookupKey(Key(50), 100), &value, &s));
+  ASSERT_OK(s);
+  ASSERT_EQ("v50", value);
+
+  // Missing keys rarely search the table
+  counting.count = 0;
+  for (int i = 100; i < 1000; i++) {
+    ASSERT_TRUE(!mem->Get(LookupKey(Key(i), 200), &value, &s));
+  }
+  fprintf(stderr, "900 missing => %d comparisons\n", counting.count);
+  ASSERT_LT(counting.count, 100);
+  mem->Unref();
+}
+
+TEST(DBTest, PrefixExtractors) {
+  const PrefixExtractor* fixed = NewFixedPrefixExtractor(3);
+  const PrefixExtractor* delimited = NewDelimitedPrefixExtractor(':', 2);
+  Slice prefix;
+  ASSERT_TRUE(fixed->Extract("abcd", &prefix));
+  ASSERT_EQ("abc", prefix.ToString());
+  ASSERT_TRUE(!fixed->Extract("ab", &prefix));
+  ASSERT_TRUE(delimited->Extract("a:b:c", &prefix));
+  ASSERT_EQ("a:b:", prefix.ToString());
+  ASSERT_TRUE(!delimited->Extract("a:b", &prefix));
+  ASSERT_EQ(std::string("leveldb.FixedPrefix.3"), fixed->Name());
+  ASSERT_EQ(std::string("leveldb.DelimitedPrefix.58.2"), delimited->Name());
+  delete fixed;
+  delete delimited;
+}
+
 // Multi-threaded test:
 namespace {
 
@@ -3,7 +3,9 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include <stdio.h>
+#include <vector>
 #include "db/dbformat.h"
+#include "leveldb/prefix_extractor.h"
 #include "port/port.h"
 #include "util/coding.h"
 
@@ -111,7 +113,26 @@ void InternalFilterPolicy::CreateFilter(const Slice* keys, int n,
     mkey[i] = ExtractUserKey(keys[i]);
     // TODO(sanjay): Suppress dups?
   }
-  user_policy_->CreateFilter(keys, n, dst);
+  if (prefix_extractor_ == NULL) {
+    user_policy_->CreateFilter(keys, n, dst);
+    return;
+  }
+
+  // Add the prefixes of the keys, once for each run of keys with the same
+  // prefix
+  std::vector<Slice> with_prefixes(keys, keys + n);
+  Slice last_prefix;
+  bool has_last_prefix = false;
+  for (int i = 0; i < n; i++) {
+    Slice prefix;
+    if (prefix_extractor_->Extract(keys[i], &prefix) &&
+        !(has_last_prefix && prefix == last_prefix)) {
+      with_prefixes.push_back(prefix);
+      last_prefix = prefix;
+      has_last_prefix = true;
+    }
+  }
+  user_policy_->CreateFilter(&with_prefixes[0], with_prefixes.size(), dst);
 }
 
 bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const {
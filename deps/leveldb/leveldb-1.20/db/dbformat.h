@@ -16,8 +16,8 @@
 
 namespace leveldb {
 
-// Grouping of constants.  We may want to make some of these
-// parameters set via options.
+// Grouping of constants.  The level-0 triggers and kMaxMemCompactLevel are
+// the defaults of the corresponding fields of Options.
 namespace config {
 static const int kNumLevels = 7;
 
@@ -131,8 +131,10 @@ class InternalKeyComparator : public Comparator {
 class InternalFilterPolicy : public FilterPolicy {
  private:
   const FilterPolicy* const user_policy_;
+  const PrefixExtractor* const prefix_extractor_;
  public:
-  explicit InternalFilterPolicy(const FilterPolicy* p) : user_policy_(p) { }
+  InternalFilterPolicy(const FilterPolicy* p, const PrefixExtractor* e)
+      : user_policy_(p), prefix_extractor_(e) { }
   virtual const char* Name() const;
   virtual void CreateFilter(const Slice* keys, int n, std::string* dst) const;
   virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const;
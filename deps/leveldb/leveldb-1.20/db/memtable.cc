@@ -8,9 +8,15 @@
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "util/coding.h"
+#include "util/hash.h"
 
 namespace leveldb {
 
+// The filter keeps all bits of a key in one 64-byte line, so that a
+// lookup costs at most one cache miss.
+static const size_t kFilterLineWords = 16;
+static const int kFilterProbes = 6;
+
 static Slice GetLengthPrefixedSlice(const char* data) {
   uint32_t len;
   const char* p = data;
@@ -18,10 +24,17 @@ static Slice GetLengthPrefixedSlice(const char* data) {
   return Slice(p, len);
 }
 
-MemTable::MemTable(const InternalKeyComparator& cmp)
+MemTable::MemTable(const InternalKeyComparator& cmp, size_t filter_bytes)
     : comparator_(cmp),
       refs_(0),
-      table_(comparator_, &arena_) {
+      table_(comparator_, &arena_),
+      filter_(NULL),
+      filter_lines_(filter_bytes / (kFilterLineWords * sizeof(uint32_t))) {
+  if (filter_lines_ > 0) {
+    const size_t bytes = filter_lines_ * kFilterLineWords * sizeof(uint32_t);
+    filter_ = reinterpret_cast<uint32_t*>(arena_.AllocateAligned(bytes));
+    memset(filter_, 0, bytes);
+  }
 }
 
 MemTable::~MemTable() {
@@ -79,6 +92,39 @@ Iterator* MemTable::NewIterator() {
   return new MemTableIterator(&table_);
 }
 
+// Return the line of "filter" that holds the bits of hash "h".
+static uint32_t* FilterLine(uint32_t* filter, size_t lines, uint32_t h) {
+  const size_t line = (static_cast<uint64_t>(h) * lines) >> 32;
+  return filter + line * kFilterLineWords;
+}
+
+static uint32_t FilterHash(const Slice& user_key) {
+  return Hash(user_key.data(), user_key.size(), 0x8c3e1d25);
+}
+
+void MemTable::AddToFilter(const Slice& user_key) {
+  uint32_t h = FilterHash(user_key);
+  uint32_t* line = FilterLine(filter_, filter_lines_, h);
+  for (int j = 0; j < kFilterProbes; j++) {
+    h *= 0x9e3779b9;  // Golden ratio, odd
+    const uint32_t bit = h >> 23;  // One of the 512 bits of the line
+    line[bit >> 5] |= (1u << (bit & 31));
+  }
+}
+
+bool MemTable::FilterMayContain(const Slice& user_key) const {
+  uint32_t h = FilterHash(user_key);
+  const uint32_t* line = FilterLine(filter_, filter_lines_, h);
+  for (int j = 0; j < kFilterProbes; j++) {
+    h *= 0x9e3779b9;
+    const uint32_t bit = h >> 23;
+    if ((line[bit >> 5] & (1u << (bit & 31))) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void MemTable::Add(SequenceNumber s, ValueType type,
                    const Slice& key,
                    const Slice& value) {
@@ -102,10 +148,17 @@ void MemTable::Add(SequenceNumber s, ValueType type,
   p = EncodeVarint32(p, val_size);
   memcpy(p, value.data(), val_size);
   assert((p + val_size) - buf == encoded_len);
+  if (filter_ != NULL) {
+    // Deletions are added too, since they hide older entries
+    AddToFilter(key);
+  }
   table_.Insert(buf);
 }
 
 bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+  if (filter_ != NULL && !FilterMayContain(key.user_key())) {
+    return false;
+  }
   Slice memkey = key.memtable_key();
   Table::Iterator iter(&table_);
   iter.Seek(memkey.data());
@@ -21,7 +21,12 @@ class MemTable {
  public:
   // MemTables are reference counted.  The initial reference count
   // is zero and the caller must call Ref() at least once.
-  explicit MemTable(const InternalKeyComparator& comparator);
+  //
+  // If "filter_bytes" is at least 64, that much of the memtable's memory
+  // holds a bloom filter of the user keys that are added, which lets Get()
+  // skip the search of the table for most keys that are not in it.
+  explicit MemTable(const InternalKeyComparator& comparator,
+                    size_t filter_bytes = 0);
 
   // Increase reference count.
   void Ref() { ++refs_; }
@@ -73,11 +78,21 @@ class MemTable {
 
   typedef SkipList<const char*, KeyComparator> Table;
 
+  void AddToFilter(const Slice& user_key);
+  bool FilterMayContain(const Slice& user_key) const;
+
   KeyComparator comparator_;
   int refs_;
   Arena arena_;
   Table table_;
 
+  // Bloom filter of the user keys in table_ with filter_lines_ lines of
+  // 64 bytes, or NULL.  Bits are only set by the single writer, before
+  // the entry is inserted into table_, so readers that can see an entry
+  // also see its bits.
+  uint32_t* filter_;
+  size_t filter_lines_;
+
   // No copying allowed
   MemTable(const MemTable&);
   void operator=(const MemTable&);
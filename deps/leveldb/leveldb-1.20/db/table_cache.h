@@ -30,10 +30,15 @@ class TableCache {
   // the returned iterator.  The returned "*tableptr" object is owned by
   // the cache and should not be deleted, and is valid for as long as the
   // returned iterator is live.
+  //
+  // If "level0" is true, the index and filter blocks of the table are
+  // pinned in the block cache if options.pin_l0_index_and_filter_blocks
+  // is set.
   Iterator* NewIterator(const ReadOptions& options,
                         uint64_t file_number,
                         uint64_t file_size,
-                        Table** tableptr = NULL);
+                        Table** tableptr = NULL,
+                        bool level0 = false);
 
   // If a seek to internal key "k" in specified file finds an entry,
   // call (*handle_result)(arg, found_key, found_value).
@@ -42,7 +47,16 @@ class TableCache {
              uint64_t file_size,
              const Slice& k,
              void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             void (*handle_result)(void*, const Slice&, const Slice&),
+             bool level0 = false);
+
+  // Returns false if the filter of the specified file shows that it has no
+  // keys with the prefix of internal key "k" (see Table::PrefixMayMatch).
+  bool PrefixMayMatch(const ReadOptions& options,
+                      uint64_t file_number,
+                      uint64_t file_size,
+                      const Slice& k,
+                      bool level0 = false);
 
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
@@ -53,7 +67,8 @@ class TableCache {
   const Options* options_;
   Cache* cache_;
 
-  Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  Status FindTable(uint64_t file_number, uint64_t file_size, bool no_io,
+                   bool level0, Cache::Handle**);
 };
 
 }  // namespace leveldb
@@ -12,6 +12,7 @@
 #include "db/memtable.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
+#include "leveldb/prefix_extractor.h"
 #include "leveldb/table_builder.h"
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
@@ -44,7 +45,7 @@ static double MaxBytesForLevel(const Options* options, int level) {
   // Result for both level-0 and level-1
   double result = 10. * 1048576.0;
   while (level > 1) {
-    result *= 10;
+    result *= options->level_size_multiplier;
     level--;
   }
   return result;
@@ -233,11 +234,17 @@ Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
 
 void Version::AddIterators(const ReadOptions& options,
                            std::vector<Iterator*>* iters) {
+  if (!options.prefix.empty()) {
+    AddPrefixIterators(options, iters);
+    return;
+  }
+
   // Merge all level zero files together since they may overlap
   for (size_t i = 0; i < files_[0].size(); i++) {
     iters->push_back(
         vset_->table_cache_->NewIterator(
-            options, files_[0][i]->number, files_[0][i]->file_size));
+            options, files_[0][i]->number, files_[0][i]->file_size,
+            NULL, true));
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
@@ -250,6 +257,104 @@ void Version::AddIterators(const ReadOptions& options,
   }
 }
 
+namespace {
+// The files of a level that overlap a prefix, and what the iterator over
+// them needs to check their filters.  The prefix is copied since the
+// files are opened after the iterator is constructed.
+struct PrefixFileList {
+  TableCache* cache;
+  std::vector<FileMetaData*> files;
+  std::string start;  // Internal key that seeks to the prefix
+};
+}
+
+// Like GetFileIterator(), but skips the file if its filter shows that it
+// has no keys with the prefix.
+static Iterator* GetPrefixFileIterator(void* arg,
+                                       const ReadOptions& options,
+                                       const Slice& file_value) {
+  PrefixFileList* list = reinterpret_cast<PrefixFileList*>(arg);
+  if (file_value.size() != 16) {
+    return NewErrorIterator(
+        Status::Corruption("FileReader invoked with unexpected value"));
+  }
+  const uint64_t number = DecodeFixed64(file_value.data());
+  const uint64_t size = DecodeFixed64(file_value.data() + 8);
+  if (!list->cache->PrefixMayMatch(options, number, size, list->start)) {
+    return NewEmptyIterator();
+  }
+  return list->cache->NewIterator(options, number, size);
+}
+
+static void DeletePrefixFileList(void* arg1, void* arg2) {
+  delete reinterpret_cast<PrefixFileList*>(arg1);
+}
+
+// Adds iterators over the files whose key ranges overlap the keys that
+// start with options.prefix.  Filters hold only the prefixes that
+// options.prefix_extractor extracts (and whole keys), so they are consulted
+// only if options.prefix is exactly such a prefix.  The files of a level
+// > 0 are concatenated and opened lazily, like in AddIterators().
+void Version::AddPrefixIterators(const ReadOptions& options,
+                                 std::vector<Iterator*>* iters) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  const PrefixExtractor* extractor = vset_->options_->prefix_extractor;
+  const Slice& prefix = options.prefix;
+  Slice extracted;
+  const bool use_filter = extractor != NULL &&
+                          extractor->Extract(prefix, &extracted) &&
+                          extracted == prefix;
+  InternalKey start(prefix, kMaxSequenceNumber, kValueTypeForSeek);
+  for (int level = 0; level < config::kNumLevels; level++) {
+    const std::vector<FileMetaData*>& files = files_[level];
+    std::vector<FileMetaData*> overlapping;
+    size_t i = 0;
+    if (level > 0) {
+      i = FindFile(vset_->icmp_, files, start.Encode());
+    }
+    for (; i < files.size(); i++) {
+      FileMetaData* f = files[i];
+      const Slice smallest = f->smallest.user_key();
+      if (ucmp->Compare(f->largest.user_key(), prefix) < 0) {
+        continue;  // Only in level 0
+      }
+      if (ucmp->Compare(smallest, prefix) > 0 &&
+          !smallest.starts_with(prefix)) {
+        if (level == 0) {
+          continue;
+        }
+        break;  // All later files are past the prefix too
+      }
+      overlapping.push_back(f);
+    }
+
+    if (level == 0) {
+      // Merge the overlapping level zero files, like in AddIterators()
+      for (size_t j = 0; j < overlapping.size(); j++) {
+        FileMetaData* f = overlapping[j];
+        if (!use_filter ||
+            vset_->table_cache_->PrefixMayMatch(options, f->number,
+                                                f->file_size, start.Encode(),
+                                                true)) {
+          iters->push_back(vset_->table_cache_->NewIterator(
+              options, f->number, f->file_size, NULL, true));
+        }
+      }
+    } else if (!overlapping.empty()) {
+      PrefixFileList* list = new PrefixFileList;
+      list->cache = vset_->table_cache_;
+      list->files.swap(overlapping);
+      list->start = start.Encode().ToString();
+      Iterator* iter = NewTwoLevelIterator(
+          new LevelFileNumIterator(vset_->icmp_, &list->files),
+          use_filter ? &GetPrefixFileIterator : &GetFileIterator,
+          use_filter ? static_cast<void*>(list) : list->cache, options);
+      iter->RegisterCleanup(&DeletePrefixFileList, list, NULL);
+      iters->push_back(iter);
+    }
+  }
+}
+
 // Callback from TableCache::Get()
 namespace {
 enum SaverState {
@@ -406,7 +511,7 @@ Status Version::Get(const ReadOptions& options,
       saver.user_key = user_key;
       saver.value = value;
       s = vset_->table_cache_->Get(options, f->number, f->file_size,
-                                   ikey, &saver, SaveValue);
+                                   ikey, &saver, SaveValue, level == 0);
       if (!s.ok()) {
         return s;
       }
@@ -501,7 +606,8 @@ bool Version::OverlapInLevel(int level,
 
 int Version::PickLevelForMemTableOutput(
     const Slice& smallest_user_key,
-    const Slice& largest_user_key) {
+    const Slice& largest_user_key,
+    uint32_t busy_levels) {
   int level = 0;
   if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
     // Push to next level if there is no overlap in next level,
@@ -509,7 +615,11 @@ int Version::PickLevelForMemTableOutput(
     InternalKey start(smallest_user_key, kMaxSequenceNumber, kValueTypeForSeek);
     InternalKey limit(largest_user_key, 0, static_cast<ValueType>(0));
     std::vector<FileMetaData*> overlaps;
-    while (level < config::kMaxMemCompactLevel) {
+    while (level < vset_->options_->max_mem_compact_level) {
+      if ((busy_levels & (1u << (level + 1))) != 0) {
+        // A running compaction may write overlapping files to it
+        break;
+      }
       if (OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
         break;
       }
@@ -1062,10 +1172,21 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
 }
 
 void VersionSet::Finalize(Version* v) {
-  // Precomputed best level for next compaction
-  int best_level = -1;
-  double best_score = -1;
+  // With dynamic level sizes, the levels above the deepest non-empty one
+  // are sized after it rather than after the fixed targets.
+  int last_level = 0;
+  double last_level_bytes = 0;
+  if (options_->dynamic_level_sizes) {
+    for (int level = config::kNumLevels - 1; level > 1; level--) {
+      if (!v->files_[level].empty()) {
+        last_level = level;
+        last_level_bytes = TotalFileSize(v->files_[level]);
+        break;
+      }
+    }
+  }
 
+  // Precomputed scores for the next compactions
   for (int level = 0; level < config::kNumLevels-1; level++) {
     double score;
     if (level == 0) {
@@ -1081,22 +1202,54 @@ void VersionSet::Finalize(Version* v) {
       // setting, or very high compression ratios, or lots of
       // overwrites/deletions).
       score = v->files_[level].size() /
-          static_cast<double>(config::kL0_CompactionTrigger);
+          static_cast<double>(options_->l0_compaction_trigger);
     } else {
       // Compute the ratio of current size to size limit.
       const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-      score =
-          static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
+      double max_bytes = MaxBytesForLevel(options_, level);
+      if (level < last_level) {
+        double dynamic_bytes = last_level_bytes;
+        for (int i = level; i < last_level; i++) {
+          dynamic_bytes /= options_->level_size_multiplier;
+        }
+        dynamic_bytes = std::max(dynamic_bytes, MaxBytesForLevel(options_, 1));
+        max_bytes = std::min(max_bytes, dynamic_bytes);
+      }
+      score = static_cast<double>(level_bytes) / max_bytes;
     }
 
-    if (score > best_score) {
+    v->compaction_scores_[level] = score;
+  }
+}
+
+// Returns true iff a compaction of "level", which reads and writes "level"
+// and "level+1", does not conflict with running compactions.
+static bool LevelsAvailable(uint32_t busy_levels, int level) {
+  return (busy_levels & (3u << level)) == 0;
+}
+
+int VersionSet::PickCompactionLevel(uint32_t busy_levels,
+                                    bool* seek_compaction) const {
+  // We prefer compactions triggered by too much data in a level over
+  // the compactions triggered by seeks.
+  int best_level = -1;
+  double best_score = 0;
+  for (int level = 0; level < config::kNumLevels-1; level++) {
+    const double score = current_->compaction_scores_[level];
+    if (score >= 1 && score > best_score &&
+        LevelsAvailable(busy_levels, level)) {
       best_level = level;
       best_score = score;
     }
   }
 
-  v->compaction_level_ = best_level;
-  v->compaction_score_ = best_score;
+  *seek_compaction = false;
+  if (best_level < 0 && current_->file_to_compact_ != NULL &&
+      LevelsAvailable(busy_levels, current_->file_to_compact_level_)) {
+    best_level = current_->file_to_compact_level_;
+    *seek_compaction = true;
+  }
+  return best_level;
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log) {
@@ -1288,16 +1441,12 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   return result;
 }
 
-Compaction* VersionSet::PickCompaction() {
+Compaction* VersionSet::PickCompaction(uint32_t busy_levels) {
   Compaction* c;
-  int level;
+  bool seek_compaction;
+  const int level = PickCompactionLevel(busy_levels, &seek_compaction);
 
-  // We prefer compactions triggered by too much data in a level over
-  // the compactions triggered by seeks.
-  const bool size_compaction = (current_->compaction_score_ >= 1);
-  const bool seek_compaction = (current_->file_to_compact_ != NULL);
-  if (size_compaction) {
-    level = current_->compaction_level_;
+  if (level >= 0 && !seek_compaction) {
     assert(level >= 0);
     assert(level+1 < config::kNumLevels);
     c = new Compaction(options_, level);
@@ -1316,7 +1465,6 @@ Compaction* VersionSet::PickCompaction() {
       c->inputs_[0].push_back(current_->files_[level][0]);
     }
   } else if (seek_compaction) {
-    level = current_->file_to_compact_level_;
     c = new Compaction(options_, level);
     c->inputs_[0].push_back(current_->file_to_compact_);
   } else {
@@ -1457,6 +1605,19 @@ Compaction::Compaction(const Options* options, int level)
   }
 }
 
+Compaction* Compaction::NewSubcompaction() const {
+  Compaction* c = new Compaction(*this);
+  c->edit_.Clear();
+  c->input_version_->Ref();
+  c->grandparent_index_ = 0;
+  c->seen_key_ = false;
+  c->overlapped_bytes_ = 0;
+  for (int i = 0; i < config::kNumLevels; i++) {
+    c->level_ptrs_[i] = 0;
+  }
+  return c;
+}
+
 Compaction::~Compaction() {
   if (input_version_ != NULL) {
     input_version_->Unref();
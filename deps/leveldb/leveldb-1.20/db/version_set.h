@@ -61,6 +61,8 @@ class Version {
   // Append to *iters a sequence of iterators that will
   // yield the contents of this Version when merged together.
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
+  // If options.prefix is set, only files that may have keys with the
+  // prefix are included.
   void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
   // Lookup the value for key.  If found, store it in *val and
@@ -105,8 +107,11 @@ class Version {
 
   // Return the level at which we should place a new memtable compaction
   // result that covers the range [smallest_user_key,largest_user_key].
+  // Levels in "busy_levels" (a bit mask) are written by running
+  // compactions, so the result is not pushed into them.
   int PickLevelForMemTableOutput(const Slice& smallest_user_key,
-                                 const Slice& largest_user_key);
+                                 const Slice& largest_user_key,
+                                 uint32_t busy_levels = 0);
 
   int NumFiles(int level) const { return files_[level].size(); }
 
@@ -119,6 +124,7 @@ class Version {
 
   class LevelFileNumIterator;
   Iterator* NewConcatenatingIterator(const ReadOptions&, int level) const;
+  void AddPrefixIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
   // Call func(arg, level, f) for every file that overlaps user_key in
   // order from newest to oldest.  If an invocation of func returns
@@ -141,18 +147,18 @@ class Version {
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
 
-  // Level that should be compacted next and its compaction score.
-  // Score < 1 means compaction is not strictly needed.  These fields
-  // are initialized by Finalize().
-  double compaction_score_;
-  int compaction_level_;
+  // Compaction score of every level that can be compacted.  Score < 1
+  // means compaction is not strictly needed.  These fields are
+  // initialized by Finalize().
+  double compaction_scores_[config::kNumLevels - 1];
 
   explicit Version(VersionSet* vset)
       : vset_(vset), next_(this), prev_(this), refs_(0),
         file_to_compact_(NULL),
-        file_to_compact_level_(-1),
-        compaction_score_(-1),
-        compaction_level_(-1) {
+        file_to_compact_level_(-1) {
+    for (int level = 0; level < config::kNumLevels - 1; level++) {
+      compaction_scores_[level] = -1;
+    }
   }
 
   ~Version();
@@ -224,11 +230,13 @@ class VersionSet {
   // being compacted, or zero if there is no such log file.
   uint64_t PrevLogNumber() const { return prev_log_number_; }
 
-  // Pick level and inputs for a new compaction.
+  // Pick level and inputs for a new compaction.  Compactions that would
+  // read or write a level in "busy_levels", a bit mask of the levels
+  // that running compactions read or write, are not considered.
   // Returns NULL if there is no compaction to be done.
   // Otherwise returns a pointer to a heap-allocated object that
   // describes the compaction.  Caller should delete the result.
-  Compaction* PickCompaction();
+  Compaction* PickCompaction(uint32_t busy_levels = 0);
 
   // Return a compaction object for compacting the range [begin,end] in
   // the specified level.  Returns NULL if there is nothing in that
@@ -247,10 +255,11 @@ class VersionSet {
   // The caller should delete the iterator when no longer needed.
   Iterator* MakeInputIterator(Compaction* c);
 
-  // Returns true iff some level needs a compaction.
-  bool NeedsCompaction() const {
-    Version* v = current_;
-    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != NULL);
+  // Returns true iff some level needs a compaction that does not read
+  // or write a level in "busy_levels" (see PickCompaction()).
+  bool NeedsCompaction(uint32_t busy_levels = 0) const {
+    bool seek_compaction;
+    return PickCompactionLevel(busy_levels, &seek_compaction) >= 0;
   }
 
   // Add all files listed in any live version to *live.
@@ -278,6 +287,11 @@ class VersionSet {
 
   void Finalize(Version* v);
 
+  // Return the level that PickCompaction(busy_levels) would compact, or
+  // -1 if there is none.  Sets *seek_compaction if the compaction is
+  // triggered by seeks rather than by the size of the level.
+  int PickCompactionLevel(uint32_t busy_levels, bool* seek_compaction) const;
+
   void GetRange(const std::vector<FileMetaData*>& inputs,
                 InternalKey* smallest,
                 InternalKey* largest);
@@ -362,6 +376,12 @@ class Compaction {
   // is successful.
   void ReleaseInputs();
 
+  // Return a copy of this compaction with the same inputs, but with its
+  // own state for IsBaseLevelForKey() and ShouldStopBefore(), so that a
+  // key range of the compaction can be processed by another thread.
+  // REQUIRES: lock is held, both to create and to delete the result.
+  Compaction* NewSubcompaction() const;
+
  private:
   friend class Version;
   friend class VersionSet;
@@ -0,0 +1,98 @@
+#include "leveldb/write_buffer_manager.h"
+
+#include <map>
+#include "db/db_impl.h"
+#include "port/port.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+namespace {
+struct Member {
+  size_t mutable_bytes;
+  size_t immutable_bytes;
+};
+}  // namespace
+
+struct WriteBufferManager::Rep {
+  mutable port::Mutex mu;
+  std::map<DBImpl*, Member> members;
+  size_t mutable_bytes;
+  size_t immutable_bytes;
+
+  Rep() : mutable_bytes(0), immutable_bytes(0) { }
+};
+
+WriteBufferManager::WriteBufferManager(size_t buffer_size)
+    : buffer_size_(buffer_size),
+      rep_(new Rep) {
+}
+
+WriteBufferManager::~WriteBufferManager() {
+  assert(rep_->members.empty());
+  delete rep_;
+}
+
+size_t WriteBufferManager::memory_usage() const {
+  MutexLock l(&rep_->mu);
+  return rep_->mutable_bytes + rep_->immutable_bytes;
+}
+
+void WriteBufferManager::Register(DBImpl* db) {
+  MutexLock l(&rep_->mu);
+  Member& member = rep_->members[db];
+  member.mutable_bytes = 0;
+  member.immutable_bytes = 0;
+}
+
+void WriteBufferManager::Unregister(DBImpl* db) {
+  MutexLock l(&rep_->mu);
+  std::map<DBImpl*, Member>::iterator it = rep_->members.find(db);
+  assert(it != rep_->members.end());
+  rep_->mutable_bytes -= it->second.mutable_bytes;
+  rep_->immutable_bytes -= it->second.immutable_bytes;
+  rep_->members.erase(it);
+}
+
+void WriteBufferManager::SetUsage(DBImpl* db, size_t mutable_bytes,
+                                  size_t immutable_bytes) {
+  MutexLock l(&rep_->mu);
+  Member& member = rep_->members[db];
+  rep_->mutable_bytes += mutable_bytes - member.mutable_bytes;
+  rep_->immutable_bytes += immutable_bytes - member.immutable_bytes;
+  member.mutable_bytes = mutable_bytes;
+  member.immutable_bytes = immutable_bytes;
+}
+
+void WriteBufferManager::MaybeFlush() {
+  MutexLock l(&rep_->mu);
+
+  // Memtables that wait to be written are freed soon without our help,
+  // so only flush once the mutable ones take up most of the budget, or
+  // half of it when the budget is used up.
+  const size_t total = rep_->mutable_bytes + rep_->immutable_bytes;
+  if (rep_->mutable_bytes <= buffer_size_ - buffer_size_ / 8 &&
+      (total < buffer_size_ || rep_->mutable_bytes < buffer_size_ / 2)) {
+    return;
+  }
+
+  // Pick the largest memtable that is not asked to switch already
+  DBImpl* db = NULL;
+  size_t largest = 0;
+  std::map<DBImpl*, Member>::iterator it;
+  for (it = rep_->members.begin(); it != rep_->members.end(); ++it) {
+    if (it->first->switch_requested_.Acquire_Load() == NULL &&
+        it->second.mutable_bytes > largest) {
+      db = it->first;
+      largest = it->second.mutable_bytes;
+    }
+  }
+
+  // The DB switches at its next write.  It is not done here, since that
+  // would block this writer on the other DB and its stalls.
+  if (db != NULL) {
+    db->switch_requested_.Release_Store(db);
+  }
+}
+
+}  // namespace leveldb
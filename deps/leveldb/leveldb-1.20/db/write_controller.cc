@@ -0,0 +1,57 @@
+#include "db/write_controller.h"
+
+#include <algorithm>
+
+namespace leveldb {
+
+// Lowest rate that writes are paced at
+static const uint64_t kMinRate = 16 << 10;
+
+// Longest that a single write waits.  Writes that are charged more
+// than that push the delay on to the writes after them.
+static const uint64_t kMaxDelayMicros = 1000000;
+
+WriteController::WriteController(uint64_t max_rate)
+    : max_rate_(std::max(max_rate, kMinRate)),
+      rate_(max_rate_),
+      delayed_(false),
+      next_write_micros_(0),
+      last_l0_files_(0) {
+}
+
+uint64_t WriteController::GetDelay(uint64_t now_micros, int l0_files) {
+  if (!delayed_) {
+    delayed_ = true;
+    next_write_micros_ = now_micros;
+    last_l0_files_ = l0_files;
+  }
+
+  // Slow down by a fifth for every level-0 file added since the last
+  // write, and speed up by a quarter for every file removed.
+  for (; last_l0_files_ < l0_files; last_l0_files_++) {
+    rate_ = std::max(rate_ - rate_ / 5, kMinRate);
+  }
+  for (; last_l0_files_ > l0_files; last_l0_files_--) {
+    rate_ = std::min(rate_ + rate_ / 4, max_rate_);
+  }
+
+  if (next_write_micros_ <= now_micros) {
+    // Idle time does not build up credit for later writes
+    next_write_micros_ = now_micros;
+    return 0;
+  }
+  return std::min(next_write_micros_ - now_micros, kMaxDelayMicros);
+}
+
+void WriteController::Charge(uint64_t bytes) {
+  if (delayed_) {
+    next_write_micros_ += bytes * 1000000 / rate_;
+  }
+}
+
+void WriteController::Reset() {
+  delayed_ = false;
+  rate_ = max_rate_;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,50 @@
+#ifndef STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+#define STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+
+#include <stdint.h>
+
+namespace leveldb {
+
+// Paces writes while level-0 holds enough files to slow down writes.
+// Written bytes are charged against a rate, like a token bucket without
+// a burst allowance, and every write waits until the bytes of earlier
+// writes are paid for.  The rate drops while the number of level-0 files
+// grows and recovers while it shrinks, so that it settles at the rate
+// that compactions keep up with rather than running into the stop
+// trigger.
+//
+// Not thread safe; DBImpl calls it while holding its mutex.
+class WriteController {
+ public:
+  // "max_rate" is the rate in bytes per second that writes start at.
+  explicit WriteController(uint64_t max_rate);
+
+  // Returns the number of microseconds that a write at "now_micros" has
+  // to wait, with "l0_files" files in level-0.  Starts pacing writes if
+  // they are not paced yet.
+  uint64_t GetDelay(uint64_t now_micros, int l0_files);
+
+  // Accounts for "bytes" written while writes are paced.
+  void Charge(uint64_t bytes);
+
+  // Stops pacing writes, once level-0 has few enough files again.
+  void Reset();
+
+  bool delayed() const { return delayed_; }
+  uint64_t rate() const { return rate_; }
+
+ private:
+  const uint64_t max_rate_;
+  uint64_t rate_;               // Bytes per second
+  bool delayed_;
+  uint64_t next_write_micros_;  // When the charged bytes are paid for
+  int last_l0_files_;
+
+  // No copying allowed
+  WriteController(const WriteController&);
+  void operator=(const WriteController&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
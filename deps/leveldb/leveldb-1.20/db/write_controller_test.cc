@@ -0,0 +1,65 @@
+#include "db/write_controller.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+class WriteControllerTest { };
+
+TEST(WriteControllerTest, Pacing) {
+  WriteController controller(1000000);
+  ASSERT_TRUE(!controller.delayed());
+
+  // Bytes are not charged before writes are paced
+  controller.Charge(1000000);
+  ASSERT_EQ(0, controller.GetDelay(5000000, 8));
+  ASSERT_TRUE(controller.delayed());
+
+  // 1000 bytes take a millisecond at 1MB/s
+  controller.Charge(1000);
+  ASSERT_EQ(1000, controller.GetDelay(5000000, 8));
+  ASSERT_EQ(500, controller.GetDelay(5000500, 8));
+  controller.Charge(1000);
+  ASSERT_EQ(1500, controller.GetDelay(5000500, 8));
+
+  // Waiting longer than needed does not save up credit
+  ASSERT_EQ(0, controller.GetDelay(6000000, 8));
+  controller.Charge(1000);
+  ASSERT_EQ(1000, controller.GetDelay(6000000, 8));
+
+  // A single write waits one second at most
+  controller.Charge(5000000);
+  ASSERT_EQ(1000000, controller.GetDelay(6000000, 8));
+
+  controller.Reset();
+  ASSERT_TRUE(!controller.delayed());
+  ASSERT_EQ(0, controller.GetDelay(6000000, 8));
+}
+
+TEST(WriteControllerTest, RateFollowsLevel0Files) {
+  WriteController controller(1000000);
+  controller.GetDelay(0, 8);
+  ASSERT_EQ(1000000, controller.rate());
+
+  controller.GetDelay(0, 9);
+  ASSERT_EQ(800000, controller.rate());
+  controller.GetDelay(0, 11);
+  ASSERT_EQ(512000, controller.rate());
+  controller.GetDelay(0, 10);
+  ASSERT_EQ(640000, controller.rate());
+
+  // The rate does not exceed the initial rate, nor drop below 16KB/s
+  controller.GetDelay(0, 8);
+  controller.GetDelay(0, 1);
+  ASSERT_EQ(1000000, controller.rate());
+  controller.GetDelay(0, 100);
+  ASSERT_EQ(16 << 10, controller.rate());
+
+  controller.Reset();
+  ASSERT_EQ(1000000, controller.rate());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
@@ -10,10 +10,11 @@
 // length strings, may use the length of the string as the charge for
 // the string.
 //
-// A builtin cache implementation with a least-recently-used eviction
-// policy is provided.  Clients may use their own implementations if
-// they want something more sophisticated (like scan-resistance, a
-// custom eviction policy, variable cache sizing, etc.)
+// Builtin cache implementations with a least-recently-used eviction
+// policy and a scan-resistant variant of it are provided.  Clients may
+// use their own implementations if they want something more
+// sophisticated (like a custom eviction policy, variable cache sizing,
+// etc.)
 
 #ifndef STORAGE_LEVELDB_INCLUDE_CACHE_H_
 #define STORAGE_LEVELDB_INCLUDE_CACHE_H_
@@ -27,7 +28,18 @@ class Cache;
 
 // Create a new cache with a fixed size capacity.  This implementation
 // of Cache uses a least-recently-used eviction policy.
-extern Cache* NewLRUCache(size_t capacity);
+//
+// The cache is split into 2^num_shard_bits shards (at most 1024) by key
+// hash, each with its own lock and an equal share of the capacity.  More
+// shards let more threads use the cache at the same time, but evictions
+// follow the eviction policy less closely when each shard is small.
+extern Cache* NewLRUCache(size_t capacity, int num_shard_bits = 4);
+
+// Create a new cache with a fixed size capacity that resists scans.  An
+// entry that is looked up after it was inserted is protected from eviction
+// by entries that are only used once, up to 80% of the capacity.  Of the
+// unprotected entries, the least recently used one is evicted first.
+extern Cache* NewSegmentedLRUCache(size_t capacity, int num_shard_bits = 4);
 
 class Cache {
  public:
@@ -52,6 +64,17 @@ class Cache {
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) = 0;
 
+  // Like Insert(), but the entry is only evicted once no entries that were
+  // inserted with Insert() are left, as long as high priority entries take
+  // up no more than half of the capacity (80% for a segmented cache, where
+  // they count as looked up).  Used for metadata that every read needs.
+  // Default implementation calls Insert().
+  virtual Handle* InsertHighPriority(
+      const Slice& key, void* value, size_t charge,
+      void (*deleter)(const Slice& key, void* value)) {
+    return Insert(key, value, charge, deleter);
+  }
+
   // If the cache has no mapping for "key", returns NULL.
   //
   // Else return a handle that corresponds to the mapping.  The caller
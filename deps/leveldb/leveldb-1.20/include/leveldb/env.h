@@ -144,6 +144,20 @@ class Env {
   // When "function(arg)" returns, the thread will be destroyed.
   virtual void StartThread(void (*function)(void* arg), void* arg) = 0;
 
+  // Make sure that at least "number" background threads run the work
+  // passed to Schedule(), so that that many work items can run at the
+  // same time.  The default implementation does nothing, in which case
+  // work items may run one at a time.
+  virtual void SetBackgroundThreads(int number) { }
+
+  // Arrange to run "(*function)(arg)" once in a background thread that
+  // is not shared with the work passed to Schedule(), so that short and
+  // urgent work items are not queued up behind long running ones.  The
+  // default implementation calls Schedule().
+  virtual void ScheduleHighPriority(void (*function)(void* arg), void* arg) {
+    Schedule(function, arg);
+  }
+
   // *path is set to a temporary directory that can be used for testing. It may
   // or many not have just been created. The directory may or may not differ
   // between runs of the same process, but subsequent calls will return the
@@ -330,6 +344,12 @@ class EnvWrapper : public Env {
   void StartThread(void (*f)(void*), void* a) {
     return target_->StartThread(f, a);
   }
+  void SetBackgroundThreads(int number) {
+    return target_->SetBackgroundThreads(number);
+  }
+  void ScheduleHighPriority(void (*f)(void*), void* a) {
+    return target_->ScheduleHighPriority(f, a);
+  }
   virtual Status GetTestDirectory(std::string* path) {
     return target_->GetTestDirectory(path);
   }
@@ -65,6 +65,19 @@ class FilterPolicy {
 // trailing spaces in keys.
 extern const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
 
+// Return a new filter policy that uses a bloom filter like
+// NewBloomFilterPolicy(), except that all bits of a key are kept in the
+// same 64-byte cache line.  A lookup of a missing key then costs one cache
+// miss instead of several.  The false positive rate is about the same at
+// 10 bits per key, but filters are a whole number of cache lines, which
+// wastes space on filters of few keys.  The filters have a different name
+// than those of NewBloomFilterPolicy(), so tables written with one policy
+// are read without filters by the other.
+//
+// The same note about custom comparators as for NewBloomFilterPolicy()
+// applies.
+extern const FilterPolicy* NewBlockedBloomFilterPolicy(int bits_per_key);
+
 }
 
 #endif  // STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <stddef.h>
+#include "leveldb/slice.h"
 
 namespace leveldb {
 
@@ -14,7 +15,9 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class PrefixExtractor;
 class Snapshot;
+class WriteBufferManager;
 
 // DB contents are stored in a set of blocks, each of which holds a
 // sequence of key,value pairs.  Each block may be compressed before
@@ -27,6 +30,32 @@ enum CompressionType {
   kSnappyCompression = 0x1
 };
 
+// Whether writes are held up because compactions fall behind.
+enum WriteStallCondition {
+  kWriteStallNormal,   // Writes proceed
+  kWriteStallDelayed,  // Writes are paced (see Options::delayed_write_rate)
+  kWriteStallStopped   // Writes wait for a compaction
+};
+
+// What the compactions fall behind on.
+enum WriteStallCause {
+  kWriteStallNoCause,
+  kWriteStallLevel0Files,  // Level-0 has too many files
+  kWriteStallMemTables     // All write buffers are full
+};
+
+// A WriteStallListener is told when writes start or stop being held up.
+class WriteStallListener {
+ public:
+  virtual ~WriteStallListener();
+
+  // Called with the new condition and its cause by the thread that is
+  // writing.  An internal lock of the DB is held, so implementations must
+  // return quickly and must not call back into the DB.
+  virtual void OnWriteStallChange(WriteStallCondition condition,
+                                  WriteStallCause cause) = 0;
+};
+
 // Options to control the behavior of a database (passed to DB::Open)
 struct Options {
   // -------------------
@@ -74,14 +103,25 @@ struct Options {
   // on disk) before converting to a sorted on-disk file.
   //
   // Larger values increase performance, especially during bulk loads.
-  // Up to two write buffers may be held in memory at the same time,
-  // so you may wish to adjust this parameter to control memory usage.
+  // Up to max_immutable_memtables + 1 write buffers may be held in memory
+  // at the same time, so you may wish to adjust this parameter to control
+  // memory usage.
   // Also, a larger write buffer will result in a longer recovery time
   // the next time the database is opened.
   //
   // Default: 4MB
   size_t write_buffer_size;
 
+  // If greater than 0, this fraction of write_buffer_size (at most 0.25)
+  // holds a bloom filter of the keys in each write buffer, so that reads of
+  // keys that are not in a write buffer skip searching it.  This helps with
+  // large write buffers.  The filter is part of the write buffer's memory,
+  // so less data fits in it.  Like NewBloomFilterPolicy(), it must not be
+  // used with a comparator that considers different keys equal.
+  //
+  // Default: 0
+  double memtable_bloom_size_ratio;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
@@ -97,6 +137,32 @@ struct Options {
   // Default: NULL
   Cache* block_cache;
 
+  // If true, the index and filter blocks of tables are stored in
+  // block_cache with high priority, rather than kept in memory for as long
+  // as a table is open.  This bounds their memory use by the capacity of
+  // the cache, at the cost of a cache lookup per read.  Blocks of tables
+  // that are read through mmap are not stored in the cache.
+  //
+  // Default: false
+  bool cache_index_and_filter_blocks;
+
+  // If true, and cache_index_and_filter_blocks is true, the index and
+  // filter blocks of level-0 tables are held in block_cache for as long as
+  // the table is open, so that they are never evicted.  Every read
+  // consults every level-0 table.
+  //
+  // Default: false
+  bool pin_l0_index_and_filter_blocks;
+
+  // If true, new tables split their index and filter into partitions of
+  // about block_size bytes, which are read through block_cache when they
+  // are needed, and keep only a small top-level index in memory.  This
+  // makes opening tables with a large max_file_size cheap.  Tables written
+  // this way cannot be read by leveldb versions without partition support.
+  //
+  // Default: false
+  bool partition_index_and_filters;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -112,6 +178,19 @@ struct Options {
   // Default: 16
   int block_restart_interval;
 
+  // If true, data blocks end with a hash index of their user keys, which
+  // lets point lookups go straight to the right restart interval instead
+  // of binary searching the restart array.  This takes about one byte per
+  // distinct user key.  The hash index assumes that the keys of a table
+  // end in an 8-byte suffix that lookups ignore, as in tables written by
+  // a DB, and that the comparator only considers identical user keys
+  // equal.  Blocks with more than 253 restart points have no hash index.
+  // Tables with hash indexes cannot be read by leveldb versions without
+  // support for them.
+  //
+  // Default: false
+  bool data_block_hash_index;
+
   // Leveldb will write up to this amount of bytes to a file before
   // switching to a new one.
   // Most clients should leave this parameter alone.  However if your
@@ -153,6 +232,119 @@ struct Options {
   // Default: NULL
   const FilterPolicy* filter_policy;
 
+  // If non-NULL along with filter_policy, the filters of new tables also
+  // hold the prefixes of user keys, so that iterators bounded to a prefix
+  // (see ReadOptions::prefix) can skip tables without keys that have it.
+  // Tables written without the same extractor are not skipped.
+  //
+  // Default: NULL
+  const PrefixExtractor* prefix_extractor;
+
+  // If true along with filter_policy, new tables have a single filter of
+  // all their keys (or one per partition, with
+  // partition_index_and_filters) instead of one filter per 2KB of data.
+  // This takes less memory for the same false positive rate, at the cost
+  // of holding the keys of a table in memory while it is built.  Tables
+  // written this way can be read by all leveldb versions.
+  //
+  // Default: false
+  bool whole_table_filter;
+
+  // Maximum number of compactions of this database that may run
+  // concurrently.  Compactions only run concurrently if they do not
+  // involve the same levels.  They run on the background threads of env,
+  // which are shared by all databases that use it.  Opening a database
+  // asks env for at least max_background_compactions *
+  // max_subcompactions of them; env never drops threads, so this is a
+  // process-wide setting for the default env.
+  //
+  // Default: 1
+  int max_background_compactions;
+
+  // Maximum number of key ranges that a single compaction is split into.
+  // A compaction with several input files in the next level is divided
+  // into key ranges at the boundaries of those files.  The ranges are
+  // compacted in parallel on the background threads of env that are free
+  // (see max_background_compactions), and by the compacting thread.
+  //
+  // Default: 1
+  int max_subcompactions;
+
+  // Maximum number of full write buffers that may wait to be written to
+  // level-0 files.  Writes only stall for a full write buffer once this
+  // many are queued, which absorbs bursts of writes at the cost of memory.
+  // Write buffers are written to disk by a dedicated background thread,
+  // so that they are not held up by long running compactions.
+  //
+  // Default: 1
+  int max_immutable_memtables;
+
+  // If non-NULL, limits the memory of the memtables of this DB together
+  // with those of the other DBs that use the same manager.  It must
+  // outlive the DB.
+  //
+  // Default: NULL
+  WriteBufferManager* write_buffer_manager;
+
+  // Number of level-0 files at which a compaction of level-0 is started.
+  // Every read merges all level-0 files, so fewer files favor reads and
+  // more files favor writes.
+  //
+  // Default: 4
+  int l0_compaction_trigger;
+
+  // Number of level-0 files at which writes are slowed down, so that
+  // compactions can catch up.  At least l0_compaction_trigger.  See
+  // delayed_write_rate.
+  //
+  // Default: 8
+  int l0_slowdown_writes_trigger;
+
+  // Rate in bytes per second that writes are paced at once level-0 has
+  // l0_slowdown_writes_trigger files.  The rate is lowered while level-0
+  // keeps growing and raised again while compactions catch up.
+  //
+  // Default: 16MB
+  size_t delayed_write_rate;
+
+  // Number of level-0 files at which writes stop until a compaction
+  // removes some of them.  At least l0_slowdown_writes_trigger.
+  //
+  // Default: 12
+  int l0_stop_writes_trigger;
+
+  // Deepest level to which a compacted memtable is pushed if it does not
+  // overlap the levels in between.  Skipping level-0 avoids expensive
+  // level-0 compactions, but pushing too deep can waste disk space when
+  // the same keys are overwritten repeatedly.
+  //
+  // Default: 2
+  int max_mem_compact_level;
+
+  // Ratio between the target sizes of consecutive levels.  Level-1 is
+  // compacted once it exceeds 10MB, level-2 at 10MB times this ratio, and
+  // so on.  Larger ratios mean fewer levels and so less compaction work
+  // per byte written, at the cost of larger compactions.
+  //
+  // Default: 10
+  int level_size_multiplier;
+
+  // If true, the target sizes of the levels above the deepest non-empty
+  // level are derived from the actual size of that level, each level
+  // being level_size_multiplier times smaller than the one below it, but
+  // at least as large as level-1 and at most its fixed target.  This
+  // bounds the space taken up by old versions of keys in the upper levels
+  // while the database is smaller than the fixed targets anticipate.
+  //
+  // Default: false
+  bool dynamic_level_sizes;
+
+  // If non-NULL, told whenever writes start or stop being delayed or
+  // stopped.
+  //
+  // Default: NULL
+  WriteStallListener* write_stall_listener;
+
   // Create an Options object with default values for all fields.
   Options();
 };
@@ -176,10 +368,27 @@ struct ReadOptions {
   // Default: NULL
   const Snapshot* snapshot;
 
+  // If true, reads are only served from the memtables, the table cache
+  // and the block cache.  A read that would need file I/O fails with
+  // an Incomplete status instead, so that the caller can retry it on
+  // a thread that may block.
+  // Default: false
+  bool no_io;
+
+  // If non-empty, an iterator only yields the keys that start with this
+  // prefix, and stops at the first key past them.  Tables whose key range
+  // or filter (see Options::prefix_extractor) rules the prefix out are
+  // not read.  The bounds assume that keys with the prefix are adjacent,
+  // as they are with the default comparator.  The data must remain live
+  // while the iterator is constructed.
+  // Default: empty
+  Slice prefix;
+
   ReadOptions()
       : verify_checksums(false),
         fill_cache(true),
-        snapshot(NULL) {
+        snapshot(NULL),
+        no_io(false) {
   }
 };
 
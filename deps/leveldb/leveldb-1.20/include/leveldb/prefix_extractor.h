@@ -0,0 +1,49 @@
+// A database can be configured with a PrefixExtractor, which maps keys to
+// prefixes that are added to the filters of tables along with the keys.
+// Iterators that are bounded to a prefix (see ReadOptions::prefix) then
+// skip the tables whose filters rule the prefix out.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PREFIX_EXTRACTOR_H_
+#define STORAGE_LEVELDB_INCLUDE_PREFIX_EXTRACTOR_H_
+
+#include <stddef.h>
+
+namespace leveldb {
+
+class Slice;
+
+class PrefixExtractor {
+ public:
+  virtual ~PrefixExtractor();
+
+  // Return the name of this extractor, including its parameters.  Tables
+  // record the name, and their filters are only used for prefixes if it
+  // matches the extractor of the database.
+  virtual const char* Name() const = 0;
+
+  // If "key" has a prefix, store it in *prefix and return true.  The
+  // prefix must be a leading part of the bytes of "key", so that the keys
+  // with a given prefix are adjacent under a bytewise comparator.
+  virtual bool Extract(const Slice& key, Slice* prefix) const = 0;
+};
+
+// Return a new extractor of the first "length" bytes of keys.  Shorter keys
+// have no prefix.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+extern const PrefixExtractor* NewFixedPrefixExtractor(size_t length);
+
+// Return a new extractor of the part of keys up to and including the
+// "count"th occurrence of "delimiter", e.g. "tenant/42/" for "tenant/42/x"
+// with a delimiter of '/' and a count of 2.  Keys with fewer delimiters
+// have no prefix.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+extern const PrefixExtractor* NewDelimitedPrefixExtractor(char delimiter,
+                                                          int count);
+
+}
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PREFIX_EXTRACTOR_H_
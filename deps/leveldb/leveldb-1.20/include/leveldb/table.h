@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_INCLUDE_TABLE_H_
 
 #include <stdint.h>
+#include "leveldb/cache.h"
 #include "leveldb/iterator.h"
 
 namespace leveldb {
@@ -13,6 +14,7 @@ namespace leveldb {
 class Block;
 class BlockHandle;
 class Footer;
+class FilterBlockReader;
 struct Options;
 class RandomAccessFile;
 struct ReadOptions;
@@ -61,6 +63,11 @@ class Table {
 
   explicit Table(Rep* rep) { rep_ = rep; }
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* IndexPartitionReader(void*, const ReadOptions&,
+                                        const Slice&);
+  Iterator* ReadBlockIterator(const ReadOptions&, const Slice& handle_value,
+                              bool high_priority,
+                              const Slice* get_target) const;
 
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
@@ -72,9 +79,27 @@ class Table {
       void (*handle_result)(void* arg, const Slice& k, const Slice& v));
 
 
+  // Returns false if the table's filter shows that it has no keys with the
+  // prefix that internal key "k" starts with, given that "k" is the first
+  // key with that prefix.  Only tables whose filters hold the prefixes of
+  // options.prefix_extractor can return false.  REQUIRES: the user key of
+  // "k" is a prefix that options.prefix_extractor extracts, since the
+  // filter holds no other prefixes.
+  bool PrefixMayMatch(const ReadOptions&, const Slice& k);
+
   void ReadMeta(const Footer& footer);
   void ReadFilter(const Slice& filter_handle_value);
 
+  // Index and filter blocks, which may be kept in the block cache.
+  Status LoadMetaBlock(const ReadOptions&, const BlockHandle& handle,
+                       bool filter, Cache::Handle** cache_handle) const;
+  Iterator* NewTopIndexIterator(const ReadOptions&) const;
+  Iterator* NewIndexIterator(const ReadOptions&) const;
+  FilterBlockReader* GetFilter(const ReadOptions&, const Slice& key,
+                               uint64_t* base,
+                               Cache::Handle** cache_handle) const;
+  void PinMetaBlocks();
+
   // No copying allowed
   Table(const Table&);
   void operator=(const Table&);
@@ -0,0 +1,57 @@
+// A WriteBufferManager limits the memory that the memtables of several
+// DBs take up together.  Once they grow beyond the budget, the DB with
+// the largest memtable is asked to switch to a new one at its next write,
+// so that the full one is written to a level-0 file and freed.  The
+// budget is soft: memtables that wait to be written still count, but
+// writes do not stop for them.
+//
+// It has internal synchronization and may be shared by DBs that are
+// used from different threads.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
+#define STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
+
+#include <stddef.h>
+
+namespace leveldb {
+
+class DBImpl;
+
+class WriteBufferManager {
+ public:
+  // Create a manager for memtables of "buffer_size" bytes in total.
+  explicit WriteBufferManager(size_t buffer_size);
+
+  // REQUIRES: All DBs that use this manager have been deleted.
+  ~WriteBufferManager();
+
+  size_t buffer_size() const { return buffer_size_; }
+
+  // Return the memory used by the memtables of all DBs that use this
+  // manager, including those that wait to be written to disk.
+  size_t memory_usage() const;
+
+ private:
+  friend class DBImpl;
+  struct Rep;
+
+  // The following are called by DBImpl.
+  void Register(DBImpl* db);
+  void Unregister(DBImpl* db);
+  // Records the memory used by the memtables of "db".
+  void SetUsage(DBImpl* db, size_t mutable_bytes, size_t immutable_bytes);
+  // If memtables take up too much memory, asks the DB with the largest
+  // memtable to switch to a new one at its next write.  Does not wait.
+  void MaybeFlush();
+
+  const size_t buffer_size_;
+  Rep* rep_;
+
+  // No copying allowed
+  WriteBufferManager(const WriteBufferManager&);
+  void operator=(const WriteBufferManager&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
@@ -17,23 +17,45 @@ namespace leveldb {
 
 inline uint32_t Block::NumRestarts() const {
   assert(size_ >= sizeof(uint32_t));
-  return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+  return DecodeFixed32(data_ + size_ - sizeof(uint32_t)) & ~kHashIndexFlag;
 }
 
 Block::Block(const BlockContents& contents)
     : data_(contents.data.data()),
       size_(contents.data.size()),
-      owned_(contents.heap_allocated) {
+      owned_(contents.heap_allocated),
+      hash_buckets_(NULL),
+      num_buckets_(0) {
   if (size_ < sizeof(uint32_t)) {
     size_ = 0;  // Error marker
-  } else {
-    size_t max_restarts_allowed = (size_-sizeof(uint32_t)) / sizeof(uint32_t);
-    if (NumRestarts() > max_restarts_allowed) {
-      // The size is too small for NumRestarts()
+    return;
+  }
+
+  // Size of the data before the restart count
+  size_t limit = size_ - sizeof(uint32_t);
+  if ((DecodeFixed32(data_ + limit) & kHashIndexFlag) != 0) {
+    if (limit < sizeof(uint16_t)) {
       size_ = 0;
-    } else {
-      restart_offset_ = size_ - (1 + NumRestarts()) * sizeof(uint32_t);
+      return;
+    }
+    limit -= sizeof(uint16_t);
+    const unsigned char* p =
+        reinterpret_cast<const unsigned char*>(data_ + limit);
+    num_buckets_ = p[0] | (p[1] << 8);
+    if (limit < num_buckets_) {
+      size_ = 0;
+      return;
     }
+    limit -= num_buckets_;
+    hash_buckets_ = data_ + limit;
+  }
+
+  size_t max_restarts_allowed = limit / sizeof(uint32_t);
+  if (NumRestarts() > max_restarts_allowed) {
+    // The size is too small for NumRestarts()
+    size_ = 0;
+  } else {
+    restart_offset_ = limit - NumRestarts() * sizeof(uint32_t);
   }
 }
 
@@ -191,7 +213,12 @@ class Block::Iter : public Iterator {
     }
 
     // Linear search (within restart block) for first key >= target
-    SeekToRestartPoint(left);
+    SeekFromRestartPoint(left, target);
+  }
+
+  // Positions at the first key >= target at or after restart point "index".
+  void SeekFromRestartPoint(uint32_t index, const Slice& target) {
+    SeekToRestartPoint(index);
     while (true) {
       if (!ParseNextKey()) {
         return;
@@ -265,4 +292,30 @@ Iterator* Block::NewIterator(const Comparator* cmp) {
   }
 }
 
+Iterator* Block::NewGetIterator(const Comparator* cmp, const Slice& target) {
+  if (size_ < sizeof(uint32_t)) {
+    return NewErrorIterator(Status::Corruption("bad block contents"));
+  }
+  const uint32_t num_restarts = NumRestarts();
+  if (num_restarts == 0) {
+    return NewEmptyIterator();
+  }
+
+  Iter* iter = new Iter(cmp, data_, restart_offset_, num_restarts);
+  uint32_t hash;
+  if (num_buckets_ == 0 || !HashIndexKey(target, &hash)) {
+    iter->Seek(target);
+    return iter;
+  }
+  const uint8_t restart = hash_buckets_[hash % num_buckets_];
+  if (restart == kHashIndexNoEntry) {
+    // Leave the iterator invalid
+  } else if (restart == kHashIndexCollision || restart >= num_restarts) {
+    iter->Seek(target);
+  } else {
+    iter->SeekFromRestartPoint(restart, target);
+  }
+  return iter;
+}
+
 }  // namespace leveldb
@@ -24,6 +24,12 @@ class Block {
   size_t size() const { return size_; }
   Iterator* NewIterator(const Comparator* comparator);
 
+  // Returns an iterator positioned as if by Seek(target), for a lookup of
+  // the user key of "target" (see options.data_block_hash_index).  The
+  // iterator may be invalid instead if the block has no entry for that
+  // user key.
+  Iterator* NewGetIterator(const Comparator* comparator, const Slice& target);
+
  private:
   uint32_t NumRestarts() const;
 
@@ -31,6 +37,8 @@ class Block {
   size_t size_;
   uint32_t restart_offset_;     // Offset in data_ of restart array
   bool owned_;                  // Block owns data_[]
+  const char* hash_buckets_;    // Hash index, if num_buckets_ > 0
+  uint32_t num_buckets_;
 
   // No copying allowed
   Block(const Block&);
@@ -32,6 +32,7 @@
 #include <assert.h>
 #include "leveldb/comparator.h"
 #include "leveldb/table_builder.h"
+#include "table/format.h"
 #include "util/coding.h"
 
 namespace leveldb {
@@ -40,7 +41,8 @@ BlockBuilder::BlockBuilder(const Options* options)
     : options_(options),
       restarts_(),
       counter_(0),
-      finished_(false) {
+      finished_(false),
+      hash_index_(false) {
   assert(options->block_restart_interval >= 1);
   restarts_.push_back(0);       // First restart point is at offset 0
 }
@@ -52,11 +54,23 @@ void BlockBuilder::Reset() {
   counter_ = 0;
   finished_ = false;
   last_key_.clear();
+  hash_index_ = false;
+  hashes_.clear();
+}
+
+// Returns the number of hash index buckets for "n" user keys.
+static size_t NumHashBuckets(size_t n) {
+  return std::min<size_t>(n + n / 3 + 1, 0xffff);
 }
 
 size_t BlockBuilder::CurrentSizeEstimate() const {
+  size_t hash_index_size = 0;
+  if (hash_index_) {
+    hash_index_size = NumHashBuckets(hashes_.size()) + sizeof(uint16_t);
+  }
   return (buffer_.size() +                        // Raw data buffer
           restarts_.size() * sizeof(uint32_t) +   // Restart array
+          hash_index_size +                       // Hash index
           sizeof(uint32_t));                      // Restart array length
 }
 
@@ -65,17 +79,42 @@ Slice BlockBuilder::Finish() {
   for (size_t i = 0; i < restarts_.size(); i++) {
     PutFixed32(&buffer_, restarts_[i]);
   }
-  PutFixed32(&buffer_, restarts_.size());
+  uint32_t num_restarts = restarts_.size();
+  if (hash_index_ && num_restarts <= kHashIndexMaxRestarts) {
+    AppendHashIndex();
+    num_restarts |= kHashIndexFlag;
+  }
+  PutFixed32(&buffer_, num_restarts);
   finished_ = true;
   return Slice(buffer_);
 }
 
+void BlockBuilder::AppendHashIndex() {
+  const size_t num_buckets = NumHashBuckets(hashes_.size());
+  std::string buckets(num_buckets, static_cast<char>(kHashIndexNoEntry));
+  for (size_t i = 0; i < hashes_.size(); i++) {
+    char& bucket = buckets[hashes_[i].first % num_buckets];
+    const uint8_t restart = hashes_[i].second;
+    if (bucket == static_cast<char>(kHashIndexNoEntry)) {
+      bucket = restart;
+    } else if (static_cast<uint8_t>(bucket) != restart) {
+      bucket = kHashIndexCollision;
+    }
+  }
+  buffer_.append(buckets);
+  buffer_.push_back(static_cast<char>(num_buckets & 0xff));
+  buffer_.push_back(static_cast<char>(num_buckets >> 8));
+}
+
 void BlockBuilder::Add(const Slice& key, const Slice& value) {
   Slice last_key_piece(last_key_);
   assert(!finished_);
   assert(counter_ <= options_->block_restart_interval);
   assert(buffer_.empty() // No values yet?
          || options_->comparator->Compare(key, last_key_piece) > 0);
+  if (buffer_.empty()) {
+    hash_index_ = options_->data_block_hash_index;
+  }
   size_t shared = 0;
   if (counter_ < options_->block_restart_interval) {
     // See how much sharing to do with previous string
@@ -90,6 +129,18 @@ void BlockBuilder::Add(const Slice& key, const Slice& value) {
   }
   const size_t non_shared = key.size() - shared;
 
+  if (hash_index_) {
+    // Entries with the same user key only need to be indexed once
+    uint32_t hash;
+    if (!HashIndexKey(key, &hash)) {
+      hash_index_ = false;
+      hashes_.clear();
+    } else if (counter_ == 0 || last_key_piece.size() != key.size() ||
+               shared + 8 < key.size()) {
+      hashes_.push_back(std::make_pair(hash, restarts_.size() - 1));
+    }
+  }
+
   // Add "<shared><non_shared><value_size>" to buffer_
   PutVarint32(&buffer_, shared);
   PutVarint32(&buffer_, non_shared);
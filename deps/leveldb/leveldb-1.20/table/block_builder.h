@@ -47,6 +47,14 @@ class BlockBuilder {
   bool                  finished_;    // Has Finish() been called?
   std::string           last_key_;
 
+  // Hash index state, with options->data_block_hash_index at the start of
+  // the block.  hashes_ has the user key hash and restart index of each
+  // entry whose user key differs from the previous one.
+  bool                  hash_index_;
+  std::vector<std::pair<uint32_t, uint32_t> > hashes_;
+
+  void AppendHashIndex();
+
   // No copying allowed
   BlockBuilder(const BlockBuilder&);
   void operator=(const BlockBuilder&);
@@ -15,11 +15,20 @@ namespace leveldb {
 static const size_t kFilterBaseLg = 11;
 static const size_t kFilterBase = 1 << kFilterBaseLg;
 
-FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy)
-    : policy_(policy) {
+// A whole-table filter is the only filter of a block whose base is so
+// large that all block offsets map to it.
+static const size_t kWholeTableFilterBaseLg = 63;
+
+FilterBlockBuilder::FilterBlockBuilder(const FilterPolicy* policy,
+                                       bool whole_table)
+    : policy_(policy),
+      whole_table_(whole_table) {
 }
 
 void FilterBlockBuilder::StartBlock(uint64_t block_offset) {
+  if (whole_table_) {
+    return;
+  }
   uint64_t filter_index = (block_offset / kFilterBase);
   assert(filter_index >= filter_offsets_.size());
   while (filter_index > filter_offsets_.size()) {
@@ -45,7 +54,8 @@ Slice FilterBlockBuilder::Finish() {
   }
 
   PutFixed32(&result_, array_offset);
-  result_.push_back(kFilterBaseLg);  // Save encoding parameter in result
+  // Save encoding parameter in result
+  result_.push_back(whole_table_ ? kWholeTableFilterBaseLg : kFilterBaseLg);
   return Slice(result_);
 }
 
@@ -108,4 +118,8 @@ bool FilterBlockReader::KeyMayMatch(uint64_t block_offset, const Slice& key) {
   return true;  // Errors are treated as potential matches
 }
 
+bool FilterBlockReader::WholeTable() const {
+  return base_lg_ == kWholeTableFilterBaseLg && num_ == 1;
+}
+
 }
@@ -121,6 +121,32 @@ TEST(FilterBlockTest, MultiChunk) {
   ASSERT_TRUE(! reader.KeyMayMatch(9000, "bar"));
 }
 
+TEST(FilterBlockTest, WholeTable) {
+  FilterBlockBuilder builder(&policy_, true);
+  builder.StartBlock(0);
+  builder.AddKey("foo");
+  builder.StartBlock(3100);
+  builder.AddKey("bar");
+  builder.StartBlock(9000);
+  builder.AddKey("box");
+  Slice block = builder.Finish();
+  FilterBlockReader reader(&policy_, block);
+  ASSERT_TRUE(reader.WholeTable());
+
+  // All keys match at any block offset
+  ASSERT_TRUE(reader.KeyMayMatch(0, "box"));
+  ASSERT_TRUE(reader.KeyMayMatch(3100, "foo"));
+  ASSERT_TRUE(reader.KeyMayMatch(9000, "bar"));
+  ASSERT_TRUE(reader.KeyMayMatch(100000000, "foo"));
+  ASSERT_TRUE(! reader.KeyMayMatch(0, "missing"));
+  ASSERT_TRUE(! reader.KeyMayMatch(9000, "other"));
+
+  FilterBlockBuilder chunked(&policy_);
+  chunked.StartBlock(100);
+  chunked.AddKey("foo");
+  ASSERT_TRUE(! FilterBlockReader(&policy_, chunked.Finish()).WholeTable());
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
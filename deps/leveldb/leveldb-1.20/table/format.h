@@ -46,7 +46,7 @@ class BlockHandle {
 // end of every table file.
 class Footer {
  public:
-  Footer() { }
+  Footer() : partitioned_(false) { }
 
   // The block handle for the metaindex block of the table
   const BlockHandle& metaindex_handle() const { return metaindex_handle_; }
@@ -60,6 +60,12 @@ class Footer {
     index_handle_ = h;
   }
 
+  // Whether the index block is the top level of a partitioned index.  Such
+  // tables have a different magic number, so that readers that do not
+  // know about partitions reject them.
+  bool partitioned() const { return partitioned_; }
+  void set_partitioned(bool partitioned) { partitioned_ = partitioned; }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(Slice* input);
 
@@ -73,6 +79,7 @@ class Footer {
  private:
   BlockHandle metaindex_handle_;
   BlockHandle index_handle_;
+  bool partitioned_;
 };
 
 // kTableMagicNumber was picked by running
@@ -80,9 +87,30 @@ class Footer {
 // and taking the leading 64 bits.
 static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 
+// Likewise for kPartitionedTableMagicNumber, with
+//    echo http://code.google.com/p/leveldb/partitioned | sha1sum
+static const uint64_t kPartitionedTableMagicNumber = 0xf2acd95ef85ce379ull;
+
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// A data block that was built with options.data_block_hash_index ends with
+// a hash index after its restart array:
+//    buckets: uint8[num_buckets]
+//    num_buckets: fixed16
+// and has kHashIndexFlag set in its restart count.  A bucket holds the
+// restart interval of the user keys (keys without their last 8 bytes) that
+// hash to it, kHashIndexNoEntry, or kHashIndexCollision if they are in
+// different restart intervals.
+static const uint32_t kHashIndexFlag = 1u << 31;
+static const uint8_t kHashIndexNoEntry = 255;
+static const uint8_t kHashIndexCollision = 254;
+static const size_t kHashIndexMaxRestarts = kHashIndexCollision;
+
+// Returns the hash of the user key of "key" for the hash index, and false
+// if "key" is too short to have a user key.
+extern bool HashIndexKey(const Slice& key, uint32_t* hash);
+
 struct BlockContents {
   Slice data;           // Actual contents of data
   bool cachable;        // True iff data can be cached
@@ -9,16 +9,24 @@
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/prefix_extractor.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
 struct Table::Rep {
   ~Rep() {
+    if (pinned_index != NULL) {
+      options.block_cache->Release(pinned_index);
+    }
+    if (pinned_filter != NULL) {
+      options.block_cache->Release(pinned_filter);
+    }
     delete filter;
     delete [] filter_data;
     delete index_block;
@@ -33,8 +41,62 @@ struct Table::Rep {
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
   Block* index_block;
+
+  // With options.cache_index_and_filter_blocks, index_block and filter are
+  // NULL and the blocks are looked up in the block cache by their handles.
+  bool cached_index;
+  bool cached_filter;
+  BlockHandle index_handle;
+  BlockHandle filter_handle;
+
+  // A partitioned table has a top-level index in place of the index block,
+  // whose values are the handles of an index partition and of its filter
+  // partition, followed by the offset that the filter partition's block
+  // offsets are relative to.  Filter partitions are only used through
+  // the block cache.
+  bool partitioned;
+  bool partitioned_filter;
+
+  // Whether the filter also holds the key prefixes of
+  // options.prefix_extractor
+  bool prefix_filtered;
+
+  // Cache handles that are held while the table is open, once pinned is
+  // non-NULL.  pin_mutex serializes pinning.
+  port::Mutex pin_mutex;
+  port::AtomicPointer pinned;
+  Cache::Handle* pinned_index;
+  Cache::Handle* pinned_filter;
+};
+
+namespace {
+
+// A filter block in the block cache.
+struct CachedFilter {
+  FilterBlockReader* reader;
+  const char* data;
 };
 
+}  // namespace
+
+static void DeleteCachedIndex(const Slice& key, void* value) {
+  delete reinterpret_cast<Block*>(value);
+}
+
+static void DeleteCachedFilter(const Slice& key, void* value) {
+  CachedFilter* filter = reinterpret_cast<CachedFilter*>(value);
+  delete filter->reader;
+  delete [] filter->data;
+  delete filter;
+}
+
+static Slice MetaBlockCacheKey(uint64_t cache_id, const BlockHandle& handle,
+                               char* buf) {
+  EncodeFixed64(buf, cache_id);
+  EncodeFixed64(buf+8, handle.offset());
+  return Slice(buf, 16);
+}
+
 Status Table::Open(const Options& options,
                    RandomAccessFile* file,
                    uint64_t size,
@@ -79,6 +141,25 @@ Status Table::Open(const Options& options,
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
     rep->filter_data = NULL;
     rep->filter = NULL;
+    rep->cached_index = false;
+    rep->cached_filter = false;
+    rep->index_handle = footer.index_handle();
+    rep->partitioned = footer.partitioned();
+    rep->partitioned_filter = false;
+    rep->prefix_filtered = false;
+    rep->pinned.NoBarrier_Store(NULL);
+    rep->pinned_index = NULL;
+    rep->pinned_filter = NULL;
+    if (options.cache_index_and_filter_blocks &&
+        options.block_cache != NULL && contents.cachable) {
+      // Hand the index block that was just read over to the cache
+      char buf[16];
+      options.block_cache->Release(options.block_cache->InsertHighPriority(
+          MetaBlockCacheKey(rep->cache_id, rep->index_handle, buf),
+          index_block, index_block->size(), &DeleteCachedIndex));
+      rep->index_block = NULL;
+      rep->cached_index = true;
+    }
     *table = new Table(rep);
     (*table)->ReadMeta(footer);
   } else {
@@ -107,11 +188,21 @@ void Table::ReadMeta(const Footer& footer) {
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
+  std::string key = rep_->partitioned ? "partitionedfilter." : "filter.";
   key.append(rep_->options.filter_policy->Name());
   iter->Seek(key);
   if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+    if (rep_->partitioned) {
+      rep_->partitioned_filter = (rep_->options.block_cache != NULL);
+    } else {
+      ReadFilter(iter->value());
+    }
+  }
+  if (rep_->options.prefix_extractor != NULL) {
+    key = "prefix.";
+    key.append(rep_->options.prefix_extractor->Name());
+    iter->Seek(key);
+    rep_->prefix_filtered = iter->Valid() && iter->key() == Slice(key);
   }
   delete iter;
   delete meta;
@@ -134,6 +225,20 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   if (!ReadBlock(rep_->file, opt, filter_handle, &block).ok()) {
     return;
   }
+  if (rep_->cached_index && block.cachable && block.heap_allocated) {
+    char buf[16];
+    CachedFilter* filter = new CachedFilter;
+    filter->reader = new FilterBlockReader(rep_->options.filter_policy,
+                                           block.data);
+    filter->data = block.data.data();
+    Cache* cache = rep_->options.block_cache;
+    cache->Release(cache->InsertHighPriority(
+        MetaBlockCacheKey(rep_->cache_id, filter_handle, buf),
+        filter, block.data.size(), &DeleteCachedFilter));
+    rep_->filter_handle = filter_handle;
+    rep_->cached_filter = true;
+    return;
+  }
   if (block.heap_allocated) {
     rep_->filter_data = block.data.data();     // Will need to delete later
   }
@@ -144,6 +249,159 @@ Table::~Table() {
   delete rep_;
 }
 
+// Looks up an index block (or a filter block if "filter" is true) in the
+// block cache, and reads it from the file and inserts it if it has been
+// evicted.  The caller must release *cache_handle.
+Status Table::LoadMetaBlock(const ReadOptions& options,
+                            const BlockHandle& handle, bool filter,
+                            Cache::Handle** cache_handle) const {
+  Cache* cache = rep_->options.block_cache;
+  char buf[16];
+  Slice key = MetaBlockCacheKey(rep_->cache_id, handle, buf);
+  *cache_handle = cache->Lookup(key);
+  if (*cache_handle != NULL) {
+    return Status::OK();
+  } else if (options.no_io) {
+    return Status::Incomplete("block not in cache");
+  }
+
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents contents;
+  Status s = ReadBlock(rep_->file, opt, handle, &contents);
+  if (!s.ok()) {
+    return s;
+  }
+  if (filter) {
+    CachedFilter* cached = new CachedFilter;
+    cached->reader = new FilterBlockReader(rep_->options.filter_policy,
+                                           contents.data);
+    cached->data = contents.heap_allocated ? contents.data.data() : NULL;
+    *cache_handle = cache->InsertHighPriority(key, cached, contents.data.size(),
+                                              &DeleteCachedFilter);
+  } else {
+    Block* block = new Block(contents);
+    *cache_handle = cache->InsertHighPriority(key, block, block->size(),
+                                              &DeleteCachedIndex);
+  }
+  return s;
+}
+
+// Holds the cached index and filter blocks until the table is deleted.
+void Table::PinMetaBlocks() {
+  if (rep_->pinned.Acquire_Load() != NULL) {
+    return;
+  }
+
+  MutexLock l(&rep_->pin_mutex);
+  if (rep_->pinned.NoBarrier_Load() != NULL) {
+    return;
+  }
+  ReadOptions options;
+  if (rep_->cached_index &&
+      !LoadMetaBlock(options, rep_->index_handle, false,
+                     &rep_->pinned_index).ok()) {
+    return;  // Try again next time
+  }
+  if (rep_->cached_filter &&
+      !LoadMetaBlock(options, rep_->filter_handle, true,
+                     &rep_->pinned_filter).ok()) {
+    rep_->pinned_filter = NULL;  // The filter is optional
+  }
+  rep_->pinned.Release_Store(rep_);
+}
+
+static void ReleaseMetaBlock(void* arg, void* h) {
+  Cache* cache = reinterpret_cast<Cache*>(arg);
+  cache->Release(reinterpret_cast<Cache::Handle*>(h));
+}
+
+// Returns an iterator over the index block, which is the top-level index
+// of a partitioned table.
+Iterator* Table::NewTopIndexIterator(const ReadOptions& options) const {
+  const Comparator* comparator = rep_->options.comparator;
+  if (!rep_->cached_index) {
+    return rep_->index_block->NewIterator(comparator);
+  }
+
+  Cache* cache = rep_->options.block_cache;
+  if (rep_->pinned.Acquire_Load() != NULL) {
+    Block* block = reinterpret_cast<Block*>(cache->Value(rep_->pinned_index));
+    return block->NewIterator(comparator);
+  }
+
+  Cache::Handle* cache_handle;
+  Status s = LoadMetaBlock(options, rep_->index_handle, false, &cache_handle);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+  Block* block = reinterpret_cast<Block*>(cache->Value(cache_handle));
+  Iterator* iter = block->NewIterator(comparator);
+  iter->RegisterCleanup(&ReleaseMetaBlock, cache, cache_handle);
+  return iter;
+}
+
+// Returns an iterator whose values are the handles of data blocks.
+Iterator* Table::NewIndexIterator(const ReadOptions& options) const {
+  Iterator* top = NewTopIndexIterator(options);
+  if (!rep_->partitioned) {
+    return top;
+  }
+  return NewTwoLevelIterator(top, &Table::IndexPartitionReader,
+                             const_cast<Table*>(this), options);
+}
+
+// Returns the filter for the data block holding "key", or NULL if the table
+// has no filter or it cannot be read.  The filter expects block offsets
+// minus *base.  The caller must release *cache_handle if it is set.
+FilterBlockReader* Table::GetFilter(const ReadOptions& options,
+                                    const Slice& key, uint64_t* base,
+                                    Cache::Handle** cache_handle) const {
+  *cache_handle = NULL;
+  *base = 0;
+  if (rep_->partitioned) {
+    if (!rep_->partitioned_filter) {
+      return NULL;
+    }
+    Iterator* top = NewTopIndexIterator(options);
+    top->Seek(key);
+    BlockHandle index_handle, filter_handle;
+    bool found = false;
+    if (top->Valid()) {
+      Slice input = top->value();
+      found = index_handle.DecodeFrom(&input).ok() &&
+              filter_handle.DecodeFrom(&input).ok() &&
+              GetVarint64(&input, base) &&
+              filter_handle.size() > 0;
+    }
+    delete top;
+    if (!found ||
+        !LoadMetaBlock(options, filter_handle, true, cache_handle).ok()) {
+      return NULL;
+    }
+    Cache* cache = rep_->options.block_cache;
+    return reinterpret_cast<CachedFilter*>(cache->Value(*cache_handle))->reader;
+  }
+  if (!rep_->cached_filter) {
+    return rep_->filter;
+  }
+
+  Cache* cache = rep_->options.block_cache;
+  Cache::Handle* pinned = NULL;
+  if (rep_->pinned.Acquire_Load() != NULL) {
+    pinned = rep_->pinned_filter;
+  } else if (!LoadMetaBlock(options, rep_->filter_handle, true,
+                            cache_handle).ok()) {
+    return NULL;
+  }
+  Cache::Handle* h = pinned != NULL ? pinned : *cache_handle;
+  return h != NULL
+      ? reinterpret_cast<CachedFilter*>(cache->Value(h))->reader
+      : NULL;
+}
+
 static void DeleteBlock(void* arg, void* ignored) {
   delete reinterpret_cast<Block*>(arg);
 }
@@ -165,7 +423,26 @@ Iterator* Table::BlockReader(void* arg,
                              const ReadOptions& options,
                              const Slice& index_value) {
   Table* table = reinterpret_cast<Table*>(arg);
-  Cache* block_cache = table->rep_->options.block_cache;
+  return table->ReadBlockIterator(options, index_value, false, NULL);
+}
+
+// Convert a top-level index value into an iterator over the corresponding
+// index partition.  Partitions are cached with high priority, like other
+// index blocks.
+Iterator* Table::IndexPartitionReader(void* arg,
+                                      const ReadOptions& options,
+                                      const Slice& index_value) {
+  Table* table = reinterpret_cast<Table*>(arg);
+  return table->ReadBlockIterator(options, index_value, true, NULL);
+}
+
+// Returns an iterator over the block, or a Block::NewGetIterator() for
+// *get_target if get_target is non-NULL.
+Iterator* Table::ReadBlockIterator(const ReadOptions& options,
+                                   const Slice& index_value,
+                                   bool high_priority,
+                                   const Slice* get_target) const {
+  Cache* block_cache = rep_->options.block_cache;
   Block* block = NULL;
   Cache::Handle* cache_handle = NULL;
 
@@ -179,24 +456,31 @@ Iterator* Table::BlockReader(void* arg,
     BlockContents contents;
     if (block_cache != NULL) {
       char cache_key_buffer[16];
-      EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
+      EncodeFixed64(cache_key_buffer, rep_->cache_id);
       EncodeFixed64(cache_key_buffer+8, handle.offset());
       Slice key(cache_key_buffer, sizeof(cache_key_buffer));
       cache_handle = block_cache->Lookup(key);
       if (cache_handle != NULL) {
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
+      } else if (options.no_io) {
+        s = Status::Incomplete("block not in cache");
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        s = ReadBlock(rep_->file, options, handle, &contents);
         if (s.ok()) {
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
-            cache_handle = block_cache->Insert(
-                key, block, block->size(), &DeleteCachedBlock);
+            cache_handle = high_priority
+                ? block_cache->InsertHighPriority(
+                      key, block, block->size(), &DeleteCachedBlock)
+                : block_cache->Insert(
+                      key, block, block->size(), &DeleteCachedBlock);
           }
         }
       }
+    } else if (options.no_io) {
+      s = Status::Incomplete("no block cache");
     } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      s = ReadBlock(rep_->file, options, handle, &contents);
       if (s.ok()) {
         block = new Block(contents);
       }
@@ -205,7 +489,9 @@ Iterator* Table::BlockReader(void* arg,
 
   Iterator* iter;
   if (block != NULL) {
-    iter = block->NewIterator(table->rep_->options.comparator);
+    iter = get_target != NULL
+        ? block->NewGetIterator(rep_->options.comparator, *get_target)
+        : block->NewIterator(rep_->options.comparator);
     if (cache_handle == NULL) {
       iter->RegisterCleanup(&DeleteBlock, block, NULL);
     } else {
@@ -219,7 +505,7 @@ Iterator* Table::BlockReader(void* arg,
 
 Iterator* Table::NewIterator(const ReadOptions& options) const {
   return NewTwoLevelIterator(
-      rep_->index_block->NewIterator(rep_->options.comparator),
+      NewIndexIterator(options),
       &Table::BlockReader, const_cast<Table*>(this), options);
 }
 
@@ -227,37 +513,79 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
                           void* arg,
                           void (*saver)(void*, const Slice&, const Slice&)) {
   Status s;
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  Cache::Handle* filter_cache_handle;
+  uint64_t filter_base;
+  FilterBlockReader* filter = GetFilter(options, k, &filter_base,
+                                        &filter_cache_handle);
+  if (filter != NULL && filter->WholeTable() && !filter->KeyMayMatch(0, k)) {
+    // Not found, without a search of the index
+  } else {
+    Iterator* iiter = NewIndexIterator(options);
+    iiter->Seek(k);
+    if (iiter->Valid()) {
+      Slice handle_value = iiter->value();
+      BlockHandle handle;
+      if (filter != NULL && !filter->WholeTable() &&
+          handle.DecodeFrom(&handle_value).ok() &&
+          handle.offset() >= filter_base &&
+          !filter->KeyMayMatch(handle.offset() - filter_base, k)) {
+        // Not found
+      } else {
+        Iterator* block_iter = ReadBlockIterator(options, iiter->value(),
+                                                 false, &k);
+        if (block_iter->Valid()) {
+          (*saver)(arg, block_iter->key(), block_iter->value());
+        }
+        s = block_iter->status();
+        delete block_iter;
+      }
+    }
+    if (s.ok()) {
+      s = iiter->status();
+    }
+    delete iiter;
+  }
+  if (filter_cache_handle != NULL) {
+    rep_->options.block_cache->Release(filter_cache_handle);
+  }
+  return s;
+}
+
+
+bool Table::PrefixMayMatch(const ReadOptions& options, const Slice& k) {
+  if (!rep_->prefix_filtered) {
+    return true;
+  }
+
+  // The first key with the prefix is in the block that a seek to it finds,
+  // so its filter has the prefix if any key has it.
+  bool may_match = true;
+  Iterator* iiter = NewIndexIterator(options);
   iiter->Seek(k);
   if (iiter->Valid()) {
     Slice handle_value = iiter->value();
-    FilterBlockReader* filter = rep_->filter;
+    Cache::Handle* filter_cache_handle;
+    uint64_t filter_base;
+    FilterBlockReader* filter = GetFilter(options, k, &filter_base,
+                                          &filter_cache_handle);
     BlockHandle handle;
     if (filter != NULL &&
         handle.DecodeFrom(&handle_value).ok() &&
-        !filter->KeyMayMatch(handle.offset(), k)) {
-      // Not found
-    } else {
-      Iterator* block_iter = BlockReader(this, options, iiter->value());
-      block_iter->Seek(k);
-      if (block_iter->Valid()) {
-        (*saver)(arg, block_iter->key(), block_iter->value());
-      }
-      s = block_iter->status();
-      delete block_iter;
+        handle.offset() >= filter_base) {
+      may_match = filter->KeyMayMatch(handle.offset() - filter_base, k);
     }
-  }
-  if (s.ok()) {
-    s = iiter->status();
+    if (filter_cache_handle != NULL) {
+      rep_->options.block_cache->Release(filter_cache_handle);
+    }
+  } else if (iiter->status().ok()) {
+    may_match = false;  // All keys are before the prefix
   }
   delete iiter;
-  return s;
+  return may_match;
 }
 
-
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
-  Iterator* index_iter =
-      rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* index_iter = NewIndexIterator(ReadOptions());
   index_iter->Seek(key);
   uint64_t result;
   if (index_iter->Valid()) {
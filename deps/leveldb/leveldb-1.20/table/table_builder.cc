@@ -9,6 +9,7 @@
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/prefix_extractor.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -26,6 +27,16 @@ struct TableBuilder::Rep {
   BlockBuilder data_block;
   BlockBuilder index_block;
   std::string last_key;
+
+  // With options.partition_index_and_filters, index_block and filter_block
+  // hold the current partition, which is written once index_block reaches
+  // options.block_size.  top_index_block maps the last key of each
+  // partition to its index block, its filter block and filter_base, the
+  // file offset that the offsets in its filter block are relative to.
+  const bool partitioned;
+  BlockBuilder top_index_block;
+  uint64_t filter_base;
+
   int64_t num_entries;
   bool closed;          // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
@@ -51,12 +62,17 @@ struct TableBuilder::Rep {
         offset(0),
         data_block(&options),
         index_block(&index_block_options),
+        partitioned(opt.partition_index_and_filters),
+        top_index_block(&index_block_options),
+        filter_base(0),
         num_entries(0),
         closed(false),
         filter_block(opt.filter_policy == NULL ? NULL
-                     : new FilterBlockBuilder(opt.filter_policy)),
+                     : new FilterBlockBuilder(opt.filter_policy,
+                                              opt.whole_table_filter)),
         pending_index_entry(false) {
     index_block_options.block_restart_interval = 1;
+    index_block_options.data_block_hash_index = false;
   }
 };
 
@@ -80,12 +96,21 @@ Status TableBuilder::ChangeOptions(const Options& options) {
   if (options.comparator != rep_->options.comparator) {
     return Status::InvalidArgument("changing comparator while building table");
   }
+  if (options.partition_index_and_filters != rep_->partitioned) {
+    return Status::InvalidArgument(
+        "changing index partitioning while building table");
+  }
+  if (options.whole_table_filter != rep_->options.whole_table_filter) {
+    return Status::InvalidArgument(
+        "changing whole table filter while building table");
+  }
 
   // Note that any live BlockBuilders point to rep_->options and therefore
   // will automatically pick up the updated options.
   rep_->options = options;
   rep_->index_block_options = options;
   rep_->index_block_options.block_restart_interval = 1;
+  rep_->index_block_options.data_block_hash_index = false;
   return Status::OK();
 }
 
@@ -104,6 +129,10 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
     r->pending_handle.EncodeTo(&handle_encoding);
     r->index_block.Add(r->last_key, Slice(handle_encoding));
     r->pending_index_entry = false;
+    if (r->partitioned &&
+        r->index_block.CurrentSizeEstimate() >= r->options.block_size) {
+      WritePartition();
+    }
   }
 
   if (r->filter_block != NULL) {
@@ -132,7 +161,40 @@ void TableBuilder::Flush() {
     r->status = r->file->Flush();
   }
   if (r->filter_block != NULL) {
-    r->filter_block->StartBlock(r->offset);
+    r->filter_block->StartBlock(r->offset - r->filter_base);
+  }
+}
+
+// Writes the index and filter blocks of the current partition, whose last
+// index key is r->last_key, and starts the next partition.
+void TableBuilder::WritePartition() {
+  Rep* r = rep_;
+  assert(r->partitioned && !r->pending_index_entry);
+  if (!ok() || r->index_block.empty()) return;
+
+  BlockHandle index_handle, filter_handle;
+  WriteBlock(&r->index_block, &index_handle);
+  if (ok() && r->filter_block != NULL) {
+    WriteRawBlock(r->filter_block->Finish(), kNoCompression, &filter_handle);
+    delete r->filter_block;
+    r->filter_block = new FilterBlockBuilder(r->options.filter_policy,
+                                             r->options.whole_table_filter);
+  } else {
+    filter_handle.set_offset(0);
+    filter_handle.set_size(0);
+  }
+  if (ok()) {
+    std::string handles_encoding;
+    index_handle.EncodeTo(&handles_encoding);
+    filter_handle.EncodeTo(&handles_encoding);
+    PutVarint64(&handles_encoding, r->filter_base);
+    r->top_index_block.Add(r->last_key, handles_encoding);
+
+    // The next data block starts after this partition
+    r->filter_base = r->offset;
+    if (r->filter_block != NULL) {
+      r->filter_block->StartBlock(0);
+    }
   }
 }
 
@@ -204,16 +266,36 @@ Status TableBuilder::Finish() {
 
   BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
 
+  // Write the last partition
+  if (ok() && r->partitioned) {
+    if (r->pending_index_entry) {
+      r->options.comparator->FindShortSuccessor(&r->last_key);
+      std::string handle_encoding;
+      r->pending_handle.EncodeTo(&handle_encoding);
+      r->index_block.Add(r->last_key, Slice(handle_encoding));
+      r->pending_index_entry = false;
+    }
+    WritePartition();
+  }
+
   // Write filter block
-  if (ok() && r->filter_block != NULL) {
+  if (ok() && r->filter_block != NULL && !r->partitioned) {
     WriteRawBlock(r->filter_block->Finish(), kNoCompression,
                   &filter_block_handle);
   }
 
   // Write metaindex block
   if (ok()) {
-    BlockBuilder meta_index_block(&r->options);
-    if (r->filter_block != NULL) {
+    Options meta_index_options = r->options;
+    meta_index_options.comparator = BytewiseComparator();
+    meta_index_options.data_block_hash_index = false;
+    BlockBuilder meta_index_block(&meta_index_options);
+    if (r->filter_block != NULL && r->partitioned) {
+      // Mark that the partitions have filters with empty data
+      std::string key = "partitionedfilter.";
+      key.append(r->options.filter_policy->Name());
+      meta_index_block.Add(key, Slice());
+    } else if (r->filter_block != NULL) {
       // Add mapping from "filter.Name" to location of filter data
       std::string key = "filter.";
       key.append(r->options.filter_policy->Name());
@@ -222,6 +304,13 @@ Status TableBuilder::Finish() {
       meta_index_block.Add(key, handle_encoding);
     }
 
+    if (r->filter_block != NULL && r->options.prefix_extractor != NULL) {
+      // Record that the filters hold the prefixes of this extractor
+      std::string key = "prefix.";
+      key.append(r->options.prefix_extractor->Name());
+      meta_index_block.Add(key, Slice());
+    }
+
     // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
   }
@@ -235,7 +324,8 @@ Status TableBuilder::Finish() {
       r->index_block.Add(r->last_key, Slice(handle_encoding));
       r->pending_index_entry = false;
     }
-    WriteBlock(&r->index_block, &index_block_handle);
+    WriteBlock(r->partitioned ? &r->top_index_block : &r->index_block,
+               &index_block_handle);
   }
 
   // Write footer
@@ -243,6 +333,7 @@ Status TableBuilder::Finish() {
     Footer footer;
     footer.set_metaindex_handle(metaindex_block_handle);
     footer.set_index_handle(index_block_handle);
+    footer.set_partitioned(r->partitioned);
     std::string footer_encoding;
     footer.EncodeTo(&footer_encoding);
     r->status = r->file->Append(footer_encoding);
@@ -407,6 +407,8 @@ struct TestArgs {
   TestType type;
   bool reverse_compare;
   int restart_interval;
+  bool partitioned;
+  bool hash_index;
 };
 
 static const TestArgs kTestArgList[] = {
@@ -416,6 +418,9 @@ static const TestArgs kTestArgList[] = {
   { TABLE_TEST, true, 16 },
   { TABLE_TEST, true, 1 },
   { TABLE_TEST, true, 1024 },
+  { TABLE_TEST, false, 16, true },
+  { TABLE_TEST, true, 1, true },
+  { TABLE_TEST, false, 16, false, true },
 
   { BLOCK_TEST, false, 16 },
   { BLOCK_TEST, false, 1 },
@@ -423,6 +428,8 @@ static const TestArgs kTestArgList[] = {
   { BLOCK_TEST, true, 16 },
   { BLOCK_TEST, true, 1 },
   { BLOCK_TEST, true, 1024 },
+  { BLOCK_TEST, false, 16, false, true },
+  { BLOCK_TEST, true, 1, false, true },
 
   // Restart interval does not matter for memtables
   { MEMTABLE_TEST, false, 16 },
@@ -431,6 +438,8 @@ static const TestArgs kTestArgList[] = {
   // Do not bother with restart interval variations for DB
   { DB_TEST, false, 16 },
   { DB_TEST, true, 16 },
+  { DB_TEST, false, 16, true },
+  { DB_TEST, false, 16, false, true },
 };
 static const int kNumTestArgs = sizeof(kTestArgList) / sizeof(kTestArgList[0]);
 
@@ -447,6 +456,8 @@ class Harness {
     // Use shorter block size for tests to exercise block boundary
     // conditions more.
     options_.block_size = 256;
+    options_.partition_index_and_filters = args.partitioned;
+    options_.data_block_hash_index = args.hash_index;
     if (args.reverse_compare) {
       options_.comparator = &reverse_key_comparator;
     }
@@ -735,7 +746,7 @@ TEST(Harness, Randomized) {
 
 TEST(Harness, RandomizedLongDB) {
   Random rnd(test::RandomSeed());
-  TestArgs args = { DB_TEST, false, 16 };
+  TestArgs args = { DB_TEST, false, 16, false, false };
   Init(args);
   int num_entries = 100000;
   for (int e = 0; e < num_entries; e++) {
@@ -827,6 +838,79 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
 
 }
 
+TEST(TableTest, ApproximateOffsetOfPartitioned) {
+  TableConstructor c(BytewiseComparator());
+  for (int i = 0; i < 100; i++) {
+    char key[10];
+    snprintf(key, sizeof(key), "k%03d", i);
+    c.Add(key, std::string(1000, 'x'));
+  }
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 64;  // Many index partitions
+  options.compression = kNoCompression;
+  options.partition_index_and_filters = true;
+  c.Finish(options, &keys, &kvmap);
+
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("abc"),      0,      0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k000"),     0,      0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k010"), 10000,  12000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k050"), 50000,  56000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 100000, 115000));
+}
+
+TEST(TableTest, BlockHashIndex) {
+  InternalKeyComparator cmp(BytewiseComparator());
+  Options options;
+  options.comparator = &cmp;
+  options.block_restart_interval = 4;
+  options.data_block_hash_index = true;
+  BlockBuilder builder(&options);
+
+  // Up to three versions of each user key, some across restart points
+  for (int i = 0; i < 100; i++) {
+    char user_key[10];
+    snprintf(user_key, sizeof(user_key), "k%04d", 2 * i);
+    for (int seq = 1 + i % 3; seq > 0; seq--) {
+      std::string key;
+      AppendInternalKey(&key, ParsedInternalKey(user_key, seq, kTypeValue));
+      builder.Add(key, "v");
+    }
+  }
+  std::string data = builder.Finish().ToString();
+  const uint32_t num_restarts = DecodeFixed32(data.data() + data.size() - 4);
+  ASSERT_TRUE((num_restarts & kHashIndexFlag) != 0);
+
+  BlockContents contents;
+  contents.data = data;
+  contents.cachable = false;
+  contents.heap_allocated = false;
+  Block block(contents);
+
+  for (int i = 0; i < 200; i++) {
+    char user_key[10];
+    snprintf(user_key, sizeof(user_key), "k%04d", i);
+    for (SequenceNumber seq = 1; seq <= 3; seq++) {
+      InternalKey target(user_key, seq, kValueTypeForSeek);
+      Iterator* iter = block.NewGetIterator(&cmp, target.Encode());
+      ParsedInternalKey found;
+      bool present = iter->Valid() && ParseInternalKey(iter->key(), &found) &&
+                     found.user_key == Slice(user_key);
+      if (i % 2 == 1) {
+        ASSERT_TRUE(!present) << user_key;
+      } else {
+        // The newest version that is visible at seq
+        ASSERT_TRUE(present) << user_key;
+        ASSERT_EQ(std::min<SequenceNumber>(seq, 1 + (i / 2) % 3),
+                  found.sequence);
+      }
+      ASSERT_OK(iter->status());
+      delete iter;
+    }
+  }
+}
+
 static bool SnappyCompressionSupported() {
   std::string out;
   Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
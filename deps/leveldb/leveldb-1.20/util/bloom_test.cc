@@ -25,9 +25,10 @@ class BloomTest {
   std::vector<std::string> keys_;
 
  public:
-  BloomTest() : policy_(NewBloomFilterPolicy(10)) { }
+  explicit BloomTest(const FilterPolicy* policy = NewBloomFilterPolicy(10))
+      : policy_(policy) { }
 
-  ~BloomTest() {
+  virtual ~BloomTest() {
     delete policy_;
   }
 
@@ -67,6 +68,10 @@ class BloomTest {
     fprintf(stderr, ")\n");
   }
 
+  const std::string& Filter() const {
+    return filter_;
+  }
+
   bool Matches(const Slice& s) {
     if (!keys_.empty()) {
       Build();
@@ -84,6 +89,17 @@ class BloomTest {
     }
     return result / 10000.0;
   }
+
+  // Checks the size of a filter that was built for "length" keys
+  virtual void CheckFilterSize(int length) {
+    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 40))
+        << length;
+  }
+
+  // Builds filters for increasing numbers of keys.  Their false positive
+  // rate must not exceed "max_rate", and may only exceed "mediocre_rate"
+  // for a few of them.
+  void CheckVaryingLengths(double max_rate, double mediocre_rate);
 };
 
 TEST(BloomTest, EmptyFilter) {
@@ -113,7 +129,7 @@ static int NextLength(int length) {
   return length;
 }
 
-TEST(BloomTest, VaryingLengths) {
+void BloomTest::CheckVaryingLengths(double max_rate, double mediocre_rate) {
   char buffer[sizeof(int)];
 
   // Count number of filters that significantly exceed the false positive rate
@@ -127,8 +143,7 @@ TEST(BloomTest, VaryingLengths) {
     }
     Build();
 
-    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 40))
-        << length;
+    CheckFilterSize(length);
 
     // All added keys must match
     for (int i = 0; i < length; i++) {
@@ -142,8 +157,8 @@ TEST(BloomTest, VaryingLengths) {
       fprintf(stderr, "False positives: %5.2f%% @ length = %6d ; bytes = %6d\n",
               rate*100.0, length, static_cast<int>(FilterSize()));
     }
-    ASSERT_LE(rate, 0.02);   // Must not be over 2%
-    if (rate > 0.0125) mediocre_filters++;  // Allowed, but not too often
+    ASSERT_LE(rate, max_rate);
+    if (rate > mediocre_rate) mediocre_filters++;  // Allowed, but not too often
     else good_filters++;
   }
   if (kVerbose >= 1) {
@@ -153,6 +168,58 @@ TEST(BloomTest, VaryingLengths) {
   ASSERT_LE(mediocre_filters, good_filters/5);
 }
 
+TEST(BloomTest, VaryingLengths) {
+  CheckVaryingLengths(0.02, 0.0125);   // Must not be over 2%
+}
+
+class BlockedBloomTest : public BloomTest {
+ public:
+  BlockedBloomTest() : BloomTest(NewBlockedBloomFilterPolicy(10)) { }
+
+  virtual void CheckFilterSize(int length) {
+    // A whole number of lines plus the number of probes and the version
+    ASSERT_EQ(2, FilterSize() % 64) << length;
+    ASSERT_LE(FilterSize(), static_cast<size_t>((length * 10 / 8) + 66))
+        << length;
+  }
+};
+
+TEST(BlockedBloomTest, EmptyFilter) {
+  ASSERT_TRUE(! Matches("hello"));
+  ASSERT_TRUE(! Matches("world"));
+}
+
+TEST(BlockedBloomTest, Small) {
+  Add("hello");
+  Add("world");
+  ASSERT_TRUE(Matches("hello"));
+  ASSERT_TRUE(Matches("world"));
+  ASSERT_TRUE(! Matches("x"));
+  ASSERT_TRUE(! Matches("foo"));
+}
+
+TEST(BlockedBloomTest, VaryingLengths) {
+  CheckVaryingLengths(0.025, 0.015);
+}
+
+TEST(BlockedBloomTest, OtherFormats) {
+  // Readers of the original format consider blocked filters a match
+  const FilterPolicy* original = NewBloomFilterPolicy(10);
+  Add("hello");
+  Build();
+  ASSERT_TRUE(original->KeyMayMatch("x", Filter()));
+
+  // and blocked readers do the same for filters of the original format
+  const FilterPolicy* blocked = NewBlockedBloomFilterPolicy(10);
+  Slice key("hello");
+  std::string filter;
+  original->CreateFilter(&key, 1, &filter);
+  ASSERT_TRUE(!original->KeyMayMatch("x", filter));
+  ASSERT_TRUE(blocked->KeyMayMatch("x", filter));
+  delete blocked;
+  delete original;
+}
+
 // Different bits-per-byte
 
 }  // namespace leveldb
@@ -36,6 +36,20 @@ namespace {
 // Elements are moved between these lists by the Ref() and Unref() methods,
 // when they detect an element in the cache acquiring or losing its only
 // external reference.
+//
+// A segmented cache splits the LRU list in two.  Items enter the probationary
+// list, and move to the protected list when they are looked up again.  Once
+// protected items take up more than their share of the capacity, the oldest
+// ones that are not in use go back to the newest end of the probationary
+// list.  Items are evicted from the probationary list first, so a scan
+// that reads many items only once cannot evict the items that are read
+// repeatedly.  High priority items are protected when they are inserted,
+// in a plain LRU cache as well as in a segmented one.
+//
+// Items whose last reference is dropped are collected on a garbage list
+// while the mutex is held, and passed to their deleter after it has been
+// released.  Deleters free whole blocks, which would otherwise hold up
+// other threads that use the same shard.
 
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
@@ -48,6 +62,7 @@ struct LRUHandle {
   size_t charge;      // TODO(opt): Only allow uint32_t?
   size_t key_length;
   bool in_cache;      // Whether entry is in the cache.
+  bool in_protected;  // Whether entry is in the protected segment.
   uint32_t refs;      // References, including cache reference, if present.
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
   char key_data[1];   // Beginning of key
@@ -158,10 +173,18 @@ class LRUCache {
   // Separate from constructor so caller can easily make an array of LRUCache
   void SetCapacity(size_t capacity) { capacity_ = capacity; }
 
+  // Items are only protected if this is non-zero.  If "segmented" is
+  // false, only high priority items are.
+  void SetProtectedCapacity(size_t capacity, bool segmented) {
+    protected_capacity_ = capacity;
+    segmented_ = segmented;
+  }
+
   // Like Cache methods, but with an extra "hash" parameter.
   Cache::Handle* Insert(const Slice& key, uint32_t hash,
                         void* value, size_t charge,
-                        void (*deleter)(const Slice& key, void* value));
+                        void (*deleter)(const Slice& key, void* value),
+                        bool high_priority);
   Cache::Handle* Lookup(const Slice& key, uint32_t hash);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
@@ -176,32 +199,55 @@ class LRUCache {
   void LRU_Append(LRUHandle*list, LRUHandle* e);
   void Ref(LRUHandle* e);
   void Unref(LRUHandle* e);
+  LRUHandle* TakeGarbage();
+  static void DeleteGarbage(LRUHandle* garbage);
+  void Protect(LRUHandle* e);
   bool FinishErase(LRUHandle* e);
+  void EvictOldest();
 
   // Initialized before use.
   size_t capacity_;
+  size_t protected_capacity_;
+  bool segmented_;
 
   // mutex_ protects the following state.
   mutable port::Mutex mutex_;
   size_t usage_;
+  size_t protected_usage_;
 
   // Dummy head of LRU list.
   // lru.prev is newest entry, lru.next is oldest entry.
   // Entries have refs==1 and in_cache==true.
   LRUHandle lru_;
 
+  // Dummy head of the LRU list of protected entries, ordered like lru_.
+  // Entries have refs==1, in_cache==true and in_protected==true.
+  LRUHandle protected_lru_;
+
   // Dummy head of in-use list.
   // Entries are in use by clients, and have refs >= 2 and in_cache==true.
   LRUHandle in_use_;
 
+  // Entries with refs==0 that are yet to be deleted, linked through next.
+  LRUHandle* garbage_;
+
   HandleTable table_;
+
+  // Keeps the mutexes of neighbouring shards off each other's cache lines.
+  char padding_[64];
 };
 
 LRUCache::LRUCache()
-    : usage_(0) {
+    : protected_capacity_(0),
+      segmented_(false),
+      usage_(0),
+      protected_usage_(0),
+      garbage_(NULL) {
   // Make empty circular linked lists.
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  protected_lru_.next = &protected_lru_;
+  protected_lru_.prev = &protected_lru_;
   in_use_.next = &in_use_;
   in_use_.prev = &in_use_;
 }
@@ -216,6 +262,15 @@ LRUCache::~LRUCache() {
     Unref(e);
     e = next;
   }
+  for (LRUHandle* e = protected_lru_.next; e != &protected_lru_; ) {
+    LRUHandle* next = e->next;
+    assert(e->in_cache);
+    e->in_cache = false;
+    assert(e->refs == 1);  // Invariant of protected_lru_ list.
+    Unref(e);
+    e = next;
+  }
+  DeleteGarbage(TakeGarbage());
 }
 
 void LRUCache::Ref(LRUHandle* e) {
@@ -229,13 +284,49 @@ void LRUCache::Ref(LRUHandle* e) {
 void LRUCache::Unref(LRUHandle* e) {
   assert(e->refs > 0);
   e->refs--;
-  if (e->refs == 0) { // Deallocate.
+  if (e->refs == 0) { // Deallocate once mutex_ is released.
     assert(!e->in_cache);
-    (*e->deleter)(e->key(), e->value);
-    free(e);
+    e->next = garbage_;
+    garbage_ = e;
   } else if (e->in_cache && e->refs == 1) {  // No longer in use; move to lru_ list.
     LRU_Remove(e);
-    LRU_Append(&lru_, e);
+    LRU_Append(e->in_protected ? &protected_lru_ : &lru_, e);
+  }
+}
+
+// Requires mutex_ held.
+LRUHandle* LRUCache::TakeGarbage() {
+  LRUHandle* garbage = garbage_;
+  garbage_ = NULL;
+  return garbage;
+}
+
+// Must be called without holding mutex_.
+void LRUCache::DeleteGarbage(LRUHandle* garbage) {
+  while (garbage != NULL) {
+    LRUHandle* next = garbage->next;
+    (*garbage->deleter)(Slice(garbage->key_data, garbage->key_length),
+                        garbage->value);
+    free(garbage);
+    garbage = next;
+  }
+}
+
+// Moves a cached entry that is looked up again, or inserted with high
+// priority, to the protected segment, making room there by demoting the
+// oldest protected entries.
+void LRUCache::Protect(LRUHandle* e) {
+  assert(e->in_cache && !e->in_protected);
+  e->in_protected = true;
+  protected_usage_ += e->charge;
+  while (protected_usage_ > protected_capacity_ &&
+         protected_lru_.next != &protected_lru_) {
+    LRUHandle* old = protected_lru_.next;
+    assert(old->refs == 1);
+    old->in_protected = false;
+    protected_usage_ -= old->charge;
+    LRU_Remove(old);
+    LRU_Append(&lru_, old);
   }
 }
 
@@ -257,20 +348,26 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
   LRUHandle* e = table_.Lookup(key, hash);
   if (e != NULL) {
     Ref(e);
+    if (segmented_ && protected_capacity_ > 0 && !e->in_protected) {
+      Protect(e);
+    }
   }
   return reinterpret_cast<Cache::Handle*>(e);
 }
 
 void LRUCache::Release(Cache::Handle* handle) {
-  MutexLock l(&mutex_);
-  Unref(reinterpret_cast<LRUHandle*>(handle));
+  LRUHandle* garbage;
+  {
+    MutexLock l(&mutex_);
+    Unref(reinterpret_cast<LRUHandle*>(handle));
+    garbage = TakeGarbage();
+  }
+  DeleteGarbage(garbage);
 }
 
 Cache::Handle* LRUCache::Insert(
     const Slice& key, uint32_t hash, void* value, size_t charge,
-    void (*deleter)(const Slice& key, void* value)) {
-  MutexLock l(&mutex_);
-
+    void (*deleter)(const Slice& key, void* value), bool high_priority) {
   LRUHandle* e = reinterpret_cast<LRUHandle*>(
       malloc(sizeof(LRUHandle)-1 + key.size()));
   e->value = value;
@@ -279,29 +376,46 @@ Cache::Handle* LRUCache::Insert(
   e->key_length = key.size();
   e->hash = hash;
   e->in_cache = false;
+  e->in_protected = false;
   e->refs = 1;  // for the returned handle.
   memcpy(e->key_data, key.data(), key.size());
 
-  if (capacity_ > 0) {
-    e->refs++;  // for the cache's reference.
-    e->in_cache = true;
-    LRU_Append(&in_use_, e);
-    usage_ += charge;
-    FinishErase(table_.Insert(e));
-  } // else don't cache.  (Tests use capacity_==0 to turn off caching.)
+  LRUHandle* garbage;
+  {
+    MutexLock l(&mutex_);
+    if (capacity_ > 0) {
+      e->refs++;  // for the cache's reference.
+      e->in_cache = true;
+      LRU_Append(&in_use_, e);
+      usage_ += charge;
+      FinishErase(table_.Insert(e));
+      if (high_priority && protected_capacity_ > 0) {
+        Protect(e);
+      }
+    } // else don't cache.  (Tests use capacity_==0 to turn off caching.)
 
-  while (usage_ > capacity_ && lru_.next != &lru_) {
-    LRUHandle* old = lru_.next;
-    assert(old->refs == 1);
-    bool erased = FinishErase(table_.Remove(old->key(), old->hash));
-    if (!erased) {  // to avoid unused variable when compiled NDEBUG
-      assert(erased);
+    while (usage_ > capacity_ &&
+           (lru_.next != &lru_ || protected_lru_.next != &protected_lru_)) {
+      EvictOldest();
     }
+    garbage = TakeGarbage();
   }
+  DeleteGarbage(garbage);
 
   return reinterpret_cast<Cache::Handle*>(e);
 }
 
+// Evicts the oldest probationary entry, or the oldest protected entry if
+// there are no probationary entries that are not in use.
+void LRUCache::EvictOldest() {
+  LRUHandle* old = lru_.next != &lru_ ? lru_.next : protected_lru_.next;
+  assert(old->refs == 1);
+  bool erased = FinishErase(table_.Remove(old->key(), old->hash));
+  if (!erased) {  // to avoid unused variable when compiled NDEBUG
+    assert(erased);
+  }
+}
+
 // If e != NULL, finish removing *e from the cache; it has already been removed
 // from the hash table.  Return whether e != NULL.  Requires mutex_ held.
 bool LRUCache::FinishErase(LRUHandle* e) {
@@ -310,34 +424,44 @@ bool LRUCache::FinishErase(LRUHandle* e) {
     LRU_Remove(e);
     e->in_cache = false;
     usage_ -= e->charge;
+    if (e->in_protected) {
+      e->in_protected = false;
+      protected_usage_ -= e->charge;
+    }
     Unref(e);
   }
   return e != NULL;
 }
 
 void LRUCache::Erase(const Slice& key, uint32_t hash) {
-  MutexLock l(&mutex_);
-  FinishErase(table_.Remove(key, hash));
+  LRUHandle* garbage;
+  {
+    MutexLock l(&mutex_);
+    FinishErase(table_.Remove(key, hash));
+    garbage = TakeGarbage();
+  }
+  DeleteGarbage(garbage);
 }
 
 void LRUCache::Prune() {
-  MutexLock l(&mutex_);
-  while (lru_.next != &lru_) {
-    LRUHandle* e = lru_.next;
-    assert(e->refs == 1);
-    bool erased = FinishErase(table_.Remove(e->key(), e->hash));
-    if (!erased) {  // to avoid unused variable when compiled NDEBUG
-      assert(erased);
+  LRUHandle* garbage;
+  {
+    MutexLock l(&mutex_);
+    while (lru_.next != &lru_ || protected_lru_.next != &protected_lru_) {
+      EvictOldest();
     }
+    garbage = TakeGarbage();
   }
+  DeleteGarbage(garbage);
 }
 
-static const int kNumShardBits = 4;
-static const int kNumShards = 1 << kNumShardBits;
+static const int kMaxNumShardBits = 10;
 
 class ShardedLRUCache : public Cache {
  private:
-  LRUCache shard_[kNumShards];
+  const int num_shard_bits_;
+  const int num_shards_;
+  LRUCache* shard_;
   port::Mutex id_mutex_;
   uint64_t last_id_;
 
@@ -345,23 +469,44 @@ class ShardedLRUCache : public Cache {
     return Hash(s.data(), s.size(), 0);
   }
 
-  static uint32_t Shard(uint32_t hash) {
-    return hash >> (32 - kNumShardBits);
+  uint32_t Shard(uint32_t hash) const {
+    return num_shard_bits_ > 0 ? hash >> (32 - num_shard_bits_) : 0;
+  }
+
+  static int ClipShardBits(int bits) {
+    if (bits < 0) return 0;
+    if (bits > kMaxNumShardBits) return kMaxNumShardBits;
+    return bits;
   }
 
  public:
-  explicit ShardedLRUCache(size_t capacity)
-      : last_id_(0) {
-    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
-    for (int s = 0; s < kNumShards; s++) {
+  ShardedLRUCache(size_t capacity, int num_shard_bits, bool segmented)
+      : num_shard_bits_(ClipShardBits(num_shard_bits)),
+        num_shards_(1 << num_shard_bits_),
+        shard_(new LRUCache[num_shards_]),
+        last_id_(0) {
+    const size_t per_shard = (capacity + (num_shards_ - 1)) / num_shards_;
+    for (int s = 0; s < num_shards_; s++) {
       shard_[s].SetCapacity(per_shard);
+      shard_[s].SetProtectedCapacity(
+          segmented ? per_shard - per_shard / 5 : per_shard / 2, segmented);
     }
   }
-  virtual ~ShardedLRUCache() { }
+  virtual ~ShardedLRUCache() {
+    delete[] shard_;
+  }
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) {
     const uint32_t hash = HashSlice(key);
-    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                      false);
+  }
+  virtual Handle* InsertHighPriority(
+      const Slice& key, void* value, size_t charge,
+      void (*deleter)(const Slice& key, void* value)) {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                      true);
   }
   virtual Handle* Lookup(const Slice& key) {
     const uint32_t hash = HashSlice(key);
@@ -383,13 +528,13 @@ class ShardedLRUCache : public Cache {
     return ++(last_id_);
   }
   virtual void Prune() {
-    for (int s = 0; s < kNumShards; s++) {
+    for (int s = 0; s < num_shards_; s++) {
       shard_[s].Prune();
     }
   }
   virtual size_t TotalCharge() const {
     size_t total = 0;
-    for (int s = 0; s < kNumShards; s++) {
+    for (int s = 0; s < num_shards_; s++) {
       total += shard_[s].TotalCharge();
     }
     return total;
@@ -398,8 +543,12 @@ class ShardedLRUCache : public Cache {
 
 }  // end anonymous namespace
 
-Cache* NewLRUCache(size_t capacity) {
-  return new ShardedLRUCache(capacity);
+Cache* NewLRUCache(size_t capacity, int num_shard_bits) {
+  return new ShardedLRUCache(capacity, num_shard_bits, false);
+}
+
+Cache* NewSegmentedLRUCache(size_t capacity, int num_shard_bits) {
+  return new ShardedLRUCache(capacity, num_shard_bits, true);
 }
 
 }  // namespace leveldb
@@ -219,6 +219,121 @@ TEST(CacheTest, Prune) {
   ASSERT_EQ(-1, Lookup(2));
 }
 
+TEST(CacheTest, SegmentedResistsScans) {
+  const int kHot = 100;
+
+  // A scan evicts everything from a plain LRU cache...
+  for (int i = 0; i < kHot; i++) {
+    Insert(i, 1000+i);
+    ASSERT_EQ(1000+i, Lookup(i));
+  }
+  for (int i = 0; i < 10*kCacheSize; i++) {
+    Insert(kHot+i, i);
+  }
+  for (int i = 0; i < kHot; i++) {
+    ASSERT_EQ(-1, Lookup(i));
+  }
+
+  // ...but not the entries of a segmented cache that were looked up
+  delete cache_;
+  cache_ = NewSegmentedLRUCache(kCacheSize);
+  for (int i = 0; i < kHot; i++) {
+    Insert(i, 1000+i);
+    ASSERT_EQ(1000+i, Lookup(i));
+  }
+  for (int i = 0; i < 10*kCacheSize; i++) {
+    Insert(kHot+i, i);
+  }
+  for (int i = 0; i < kHot; i++) {
+    ASSERT_EQ(1000+i, Lookup(i));
+  }
+  ASSERT_LE(cache_->TotalCharge(), kCacheSize + kCacheSize/10);
+}
+
+TEST(CacheTest, SegmentedDemotesProtected) {
+  delete cache_;
+  cache_ = NewSegmentedLRUCache(kCacheSize);
+
+  // More entries are looked up than can be protected
+  for (int i = 0; i < 2*kCacheSize; i++) {
+    Insert(i, 1000+i);
+    ASSERT_EQ(1000+i, Lookup(i));
+  }
+  ASSERT_LE(cache_->TotalCharge(), kCacheSize + kCacheSize/10);
+  ASSERT_EQ(-1, Lookup(0));
+  ASSERT_EQ(1000+2*kCacheSize-1, Lookup(2*kCacheSize-1));
+
+  // New entries find room by evicting demoted ones
+  Insert(-1, 999);
+  ASSERT_EQ(999, Lookup(-1));
+
+  cache_->Prune();
+  ASSERT_EQ(0, cache_->TotalCharge());
+  ASSERT_EQ(-1, Lookup(-1));
+}
+
+TEST(CacheTest, ShardBits) {
+  const int kBits[] = { 0, 1, 8, 20 };
+  for (int b = 0; b < 4; b++) {
+    delete cache_;
+    cache_ = NewLRUCache(kCacheSize, kBits[b]);
+
+    for (int i = 0; i < 2*kCacheSize; i++) {
+      Insert(i, 1000+i);
+    }
+    // Shard capacities are rounded up, to at most 1024 shards of one entry
+    ASSERT_LE(cache_->TotalCharge(), 1024);
+    ASSERT_EQ(1000+2*kCacheSize-1, Lookup(2*kCacheSize-1));
+    ASSERT_EQ(-1, Lookup(0));
+  }
+}
+
+TEST(CacheTest, HighPriority) {
+  // High priority entries outlast entries that are inserted later...
+  for (int i = 0; i < 100; i++) {
+    cache_->Release(cache_->InsertHighPriority(EncodeKey(i), EncodeValue(i),
+                                               1, &CacheTest::Deleter));
+  }
+  for (int i = 0; i < 10*kCacheSize; i++) {
+    Insert(1000+i, i);
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(i, Lookup(i));
+  }
+
+  // ...but are evicted themselves once they don't fit
+  for (int i = 0; i < 2*kCacheSize; i++) {
+    cache_->Release(cache_->InsertHighPriority(EncodeKey(i), EncodeValue(i),
+                                               1, &CacheTest::Deleter));
+  }
+  ASSERT_LE(cache_->TotalCharge(), kCacheSize + kCacheSize/10);
+  ASSERT_EQ(-1, Lookup(0));
+  ASSERT_EQ(2*kCacheSize-1, Lookup(2*kCacheSize-1));
+}
+
+static Cache* reentrant_cache;
+
+static void ReentrantDeleter(const Slice& key, void* v) {
+  // Would deadlock if called with the shard's mutex held
+  Cache::Handle* h = reentrant_cache->Lookup(key);
+  assert(h == NULL);
+  reentrant_cache->Release(reentrant_cache->Insert(EncodeKey(2),
+                                                   EncodeValue(200), 1,
+                                                   &CacheTest::Deleter));
+}
+
+TEST(CacheTest, DeleterRunsUnlocked) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0);
+  reentrant_cache = cache_;
+
+  cache_->Release(cache_->Insert(EncodeKey(1), EncodeValue(100), 1,
+                                 &ReentrantDeleter));
+  Erase(1);
+  ASSERT_EQ(-1, Lookup(1));
+  ASSERT_EQ(200, Lookup(2));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -499,6 +499,10 @@ class PosixEnv : public Env {
 
   virtual void StartThread(void (*function)(void* arg), void* arg);
 
+  virtual void SetBackgroundThreads(int number);
+
+  virtual void ScheduleHighPriority(void (*function)(void*), void* arg);
+
   virtual Status GetTestDirectory(std::string* result) {
     const char* env = getenv("TEST_TMPDIR");
     if (env && env[0] != '\0') {
@@ -549,23 +553,35 @@ class PosixEnv : public Env {
     }
   }
 
-  // BGThread() is the body of the background thread
-  void BGThread();
+  // Entry per Schedule() call
+  struct BGItem { void* arg; void (*function)(void*); };
+  typedef std::deque<BGItem> BGQueue;
+
+  // BGThread() is the body of the background threads, which run the
+  // items of *queue
+  void BGThread(BGQueue* queue, pthread_cond_t* signal);
   static void* BGThreadWrapper(void* arg) {
-    reinterpret_cast<PosixEnv*>(arg)->BGThread();
+    PosixEnv* env = reinterpret_cast<PosixEnv*>(arg);
+    env->BGThread(&env->queue_, &env->bgsignal_);
+    return NULL;
+  }
+  static void* HighPriorityThreadWrapper(void* arg) {
+    PosixEnv* env = reinterpret_cast<PosixEnv*>(arg);
+    env->BGThread(&env->hpqueue_, &env->hpsignal_);
     return NULL;
   }
 
   pthread_mutex_t mu_;
   pthread_cond_t bgsignal_;
-  pthread_t bgthread_;
-  bool started_bgthread_;
-
-  // Entry per Schedule() call
-  struct BGItem { void* arg; void (*function)(void*); };
-  typedef std::deque<BGItem> BGQueue;
+  int started_bgthreads_;
+  int max_bgthreads_;
   BGQueue queue_;
 
+  // A single thread runs the work passed to ScheduleHighPriority()
+  pthread_cond_t hpsignal_;
+  bool started_hpthread_;
+  BGQueue hpqueue_;
+
   PosixLockTable locks_;
   Limiter mmap_limit_;
   Limiter fd_limit_;
@@ -600,29 +616,32 @@ static intptr_t MaxOpenFiles() {
 }
 
 PosixEnv::PosixEnv()
-    : started_bgthread_(false),
+    : started_bgthreads_(0),
+      max_bgthreads_(1),
+      started_hpthread_(false),
       mmap_limit_(MaxMmaps()),
       fd_limit_(MaxOpenFiles()) {
   PthreadCall("mutex_init", pthread_mutex_init(&mu_, NULL));
   PthreadCall("cvar_init", pthread_cond_init(&bgsignal_, NULL));
+  PthreadCall("cvar_init", pthread_cond_init(&hpsignal_, NULL));
 }
 
 void PosixEnv::Schedule(void (*function)(void*), void* arg) {
   PthreadCall("lock", pthread_mutex_lock(&mu_));
 
-  // Start background thread if necessary
-  if (!started_bgthread_) {
-    started_bgthread_ = true;
+  // Start background threads if necessary
+  while (started_bgthreads_ < max_bgthreads_) {
+    started_bgthreads_++;
+    pthread_t t;
     PthreadCall(
         "create thread",
-        pthread_create(&bgthread_, NULL,  &PosixEnv::BGThreadWrapper, this));
+        pthread_create(&t, NULL,  &PosixEnv::BGThreadWrapper, this));
   }
 
-  // If the queue is currently empty, the background thread may currently be
-  // waiting.
-  if (queue_.empty()) {
-    PthreadCall("signal", pthread_cond_signal(&bgsignal_));
-  }
+  // Wake up one of the background threads that may be waiting.  With more
+  // than one thread, a non-empty queue does not mean that all of them are
+  // busy, so always signal.
+  PthreadCall("signal", pthread_cond_signal(&bgsignal_));
 
   // Add to priority queue
   queue_.push_back(BGItem());
@@ -632,17 +651,50 @@ void PosixEnv::Schedule(void (*function)(void*), void* arg) {
   PthreadCall("unlock", pthread_mutex_unlock(&mu_));
 }
 
-void PosixEnv::BGThread() {
+void PosixEnv::SetBackgroundThreads(int number) {
+  PthreadCall("lock", pthread_mutex_lock(&mu_));
+  if (number > max_bgthreads_) {
+    // Threads are started by the next call to Schedule()
+    max_bgthreads_ = number;
+  }
+  PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+}
+
+void PosixEnv::ScheduleHighPriority(void (*function)(void*), void* arg) {
+  PthreadCall("lock", pthread_mutex_lock(&mu_));
+
+  // Start the high priority thread if necessary
+  if (!started_hpthread_) {
+    started_hpthread_ = true;
+    pthread_t t;
+    PthreadCall(
+        "create thread",
+        pthread_create(&t, NULL,  &PosixEnv::HighPriorityThreadWrapper, this));
+  }
+
+  // If the queue is currently empty, the thread may be waiting.
+  if (hpqueue_.empty()) {
+    PthreadCall("signal", pthread_cond_signal(&hpsignal_));
+  }
+
+  hpqueue_.push_back(BGItem());
+  hpqueue_.back().function = function;
+  hpqueue_.back().arg = arg;
+
+  PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+}
+
+void PosixEnv::BGThread(BGQueue* queue, pthread_cond_t* signal) {
   while (true) {
     // Wait until there is an item that is ready to run
     PthreadCall("lock", pthread_mutex_lock(&mu_));
-    while (queue_.empty()) {
-      PthreadCall("wait", pthread_cond_wait(&bgsignal_, &mu_));
+    while (queue->empty()) {
+      PthreadCall("wait", pthread_cond_wait(signal, &mu_));
     }
 
-    void (*function)(void*) = queue_.front().function;
-    void* arg = queue_.front().arg;
-    queue_.pop_front();
+    void (*function)(void*) = queue->front().function;
+    void* arg = queue->front().arg;
+    queue->pop_front();
 
     PthreadCall("unlock", pthread_mutex_unlock(&mu_));
     (*function)(arg);
@@ -66,6 +66,30 @@ TEST(EnvTest, RunMany) {
   ASSERT_EQ(4, reinterpret_cast<uintptr_t>(cur));
 }
 
+static void WaitForBool(void* ptr) {
+  port::AtomicPointer* flag = reinterpret_cast<port::AtomicPointer*>(ptr);
+  while (flag->Acquire_Load() == NULL) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+}
+
+TEST(EnvTest, RunHighPriority) {
+  // Occupy the background thread
+  port::AtomicPointer release (NULL);
+  env_->Schedule(&WaitForBool, &release);
+
+  port::AtomicPointer called (NULL);
+  env_->ScheduleHighPriority(&SetBool, &called);
+  env_->SleepForMicroseconds(kDelayMicros);
+  ASSERT_TRUE(called.NoBarrier_Load() != NULL);
+
+  port::AtomicPointer done (NULL);
+  release.Release_Store(&release);
+  env_->Schedule(&SetBool, &done);
+  env_->SleepForMicroseconds(kDelayMicros);
+  ASSERT_TRUE(done.NoBarrier_Load() != NULL);
+}
+
 struct State {
   port::Mutex mu;
   int val;
@@ -9,6 +9,9 @@
 
 namespace leveldb {
 
+WriteStallListener::~WriteStallListener() {
+}
+
 Options::Options()
     : comparator(BytewiseComparator()),
       create_if_missing(false),
@@ -17,14 +20,33 @@ Options::Options()
       env(Env::Default()),
       info_log(NULL),
       write_buffer_size(4<<20),
+      memtable_bloom_size_ratio(0),
       max_open_files(1000),
       block_cache(NULL),
+      cache_index_and_filter_blocks(false),
+      pin_l0_index_and_filter_blocks(false),
+      partition_index_and_filters(false),
       block_size(4096),
       block_restart_interval(16),
+      data_block_hash_index(false),
       max_file_size(2<<20),
       compression(kSnappyCompression),
       reuse_logs(false),
-      filter_policy(NULL) {
+      filter_policy(NULL),
+      prefix_extractor(NULL),
+      whole_table_filter(false),
+      max_background_compactions(1),
+      max_subcompactions(1),
+      max_immutable_memtables(1),
+      write_buffer_manager(NULL),
+      l0_compaction_trigger(4),
+      l0_slowdown_writes_trigger(8),
+      delayed_write_rate(16 << 20),
+      l0_stop_writes_trigger(12),
+      max_mem_compact_level(2),
+      level_size_multiplier(10),
+      dynamic_level_sizes(false),
+      write_stall_listener(NULL) {
 }
 
 }  // namespace leveldb
@@ -0,0 +1,80 @@
+#include "leveldb/prefix_extractor.h"
+
+#include <string>
+#include "leveldb/slice.h"
+#include "util/logging.h"
+
+namespace leveldb {
+
+PrefixExtractor::~PrefixExtractor() { }
+
+namespace {
+
+class FixedPrefixExtractor : public PrefixExtractor {
+ private:
+  size_t length_;
+  std::string name_;
+
+ public:
+  explicit FixedPrefixExtractor(size_t length)
+      : length_(length),
+        name_("leveldb.FixedPrefix.") {
+    AppendNumberTo(&name_, length);
+  }
+
+  virtual const char* Name() const {
+    return name_.c_str();
+  }
+
+  virtual bool Extract(const Slice& key, Slice* prefix) const {
+    if (key.size() < length_) {
+      return false;
+    }
+    *prefix = Slice(key.data(), length_);
+    return true;
+  }
+};
+
+class DelimitedPrefixExtractor : public PrefixExtractor {
+ private:
+  char delimiter_;
+  int count_;
+  std::string name_;
+
+ public:
+  DelimitedPrefixExtractor(char delimiter, int count)
+      : delimiter_(delimiter),
+        count_(count),
+        name_("leveldb.DelimitedPrefix.") {
+    AppendNumberTo(&name_, static_cast<unsigned char>(delimiter));
+    name_.push_back('.');
+    AppendNumberTo(&name_, count);
+  }
+
+  virtual const char* Name() const {
+    return name_.c_str();
+  }
+
+  virtual bool Extract(const Slice& key, Slice* prefix) const {
+    int found = 0;
+    for (size_t i = 0; i < key.size(); i++) {
+      if (key[i] == delimiter_ && ++found == count_) {
+        *prefix = Slice(key.data(), i + 1);
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+}  // namespace
+
+const PrefixExtractor* NewFixedPrefixExtractor(size_t length) {
+  return new FixedPrefixExtractor(length);
+}
+
+const PrefixExtractor* NewDelimitedPrefixExtractor(char delimiter, int count) {
+  return new DelimitedPrefixExtractor(delimiter, count);
+}
+
+}  // namespace leveldb
@@ -114,18 +114,22 @@ class Tester {
 #define TCONCAT(a,b) TCONCAT1(a,b)
 #define TCONCAT1(a,b) a##b
 
+// The class of a test is named after its base as well, so that tests of
+// different bases may share a name.
+#define TCLASS(base,name) TCONCAT(_Test_##base##_,name)
+
 #define TEST(base,name)                                                 \
-class TCONCAT(_Test_,name) : public base {                              \
+class TCLASS(base,name) : public base {                                 \
  public:                                                                \
   void _Run();                                                          \
   static void _RunIt() {                                                \
-    TCONCAT(_Test_,name) t;                                             \
+    TCLASS(base,name) t;                                                \
     t._Run();                                                           \
   }                                                                     \
 };                                                                      \
-bool TCONCAT(_Test_ignored_,name) =                                     \
-  ::leveldb::test::RegisterTest(#base, #name, &TCONCAT(_Test_,name)::_RunIt); \
-void TCONCAT(_Test_,name)::_Run()
+bool TCONCAT(_Test_ignored_##base##_,name) =                            \
+  ::leveldb::test::RegisterTest(#base, #name, &TCLASS(base,name)::_RunIt); \
+void TCLASS(base,name)::_Run()
 
 // Register the specified test.  Typically not used directly, but
 // invoked via the macro expansion of TEST.
@@ -34,6 +34,14 @@
         "include_dirs": [
           "port-libuv/"
         ],
+        "direct_dependent_settings": {
+          "include_dirs": [
+            "port-libuv/"
+          ],
+          "defines": [
+            "LEVELDB_PLATFORM_UV=1"
+          ]
+        },
         "defines": [
           "LEVELDB_PLATFORM_UV=1",
           "NOMINMAX=1",
@@ -58,6 +66,11 @@
           "leveldb-<(ldbversion)/port/port_posix.h",
           "leveldb-<(ldbversion)/util/env_posix.cc"
         ],
+        "direct_dependent_settings": {
+          "defines": [
+            "LEVELDB_PLATFORM_POSIX=1"
+          ]
+        },
         "defines": [
           "LEVELDB_PLATFORM_POSIX=1"
         ],
@@ -215,6 +228,9 @@
       "leveldb-<(ldbversion)/db/version_set.h",
       "leveldb-<(ldbversion)/db/write_batch.cc",
       "leveldb-<(ldbversion)/db/write_batch_internal.h",
+      "leveldb-<(ldbversion)/db/write_buffer_manager.cc",
+      "leveldb-<(ldbversion)/db/write_controller.cc",
+      "leveldb-<(ldbversion)/db/write_controller.h",
       "leveldb-<(ldbversion)/helpers/memenv/memenv.cc",
       "leveldb-<(ldbversion)/helpers/memenv/memenv.h",
       "leveldb-<(ldbversion)/include/leveldb/cache.h",
@@ -225,11 +241,13 @@
       "leveldb-<(ldbversion)/include/leveldb/filter_policy.h",
       "leveldb-<(ldbversion)/include/leveldb/iterator.h",
       "leveldb-<(ldbversion)/include/leveldb/options.h",
+      "leveldb-<(ldbversion)/include/leveldb/prefix_extractor.h",
       "leveldb-<(ldbversion)/include/leveldb/slice.h",
       "leveldb-<(ldbversion)/include/leveldb/status.h",
       "leveldb-<(ldbversion)/include/leveldb/table.h",
       "leveldb-<(ldbversion)/include/leveldb/table_builder.h",
       "leveldb-<(ldbversion)/include/leveldb/write_batch.h",
+      "leveldb-<(ldbversion)/include/leveldb/write_buffer_manager.h",
       "leveldb-<(ldbversion)/port/port.h",
       "leveldb-<(ldbversion)/port/port_posix_sse.cc",
       "leveldb-<(ldbversion)/table/block.cc",
@@ -265,6 +283,7 @@
       "leveldb-<(ldbversion)/util/logging.h",
       "leveldb-<(ldbversion)/util/mutexlock.h",
       "leveldb-<(ldbversion)/util/options.cc",
+      "leveldb-<(ldbversion)/util/prefix_extractor.cc",
       "leveldb-<(ldbversion)/util/random.h",
       "leveldb-<(ldbversion)/util/status.cc"
     ]
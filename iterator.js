@@ -8,6 +8,11 @@ function Iterator (db, options) {
 
   this.context = binding.iterator_init(db.context, options)
   this.cache = null
+  this.offsets = null
+  this.position = 0
+  this.packed = !!options.packed
+  this.keyAsBuffer = options.keyAsBuffer !== false
+  this.valueAsBuffer = options.valueAsBuffer !== false
   this.finished = false
   this.fastFuture = fastFuture()
 }
@@ -20,6 +25,7 @@ Iterator.prototype._seek = function (target) {
   }
 
   this.cache = null
+  this.offsets = null
   binding.iterator_seek(this.context, target)
   this.finished = false
 }
@@ -29,7 +35,14 @@ Iterator.prototype._next = function (callback) {
   var key
   var value
 
-  if (this.cache && this.cache.length) {
+  if (this.packed && this.offsets && this.position < this.offsets.length - 1) {
+    key = this._slice(this.keyAsBuffer)
+    value = this._slice(this.valueAsBuffer)
+
+    this.fastFuture(function () {
+      callback(null, key, value)
+    })
+  } else if (!this.packed && this.cache && this.cache.length) {
     key = this.cache.pop()
     value = this.cache.pop()
 
@@ -41,10 +54,12 @@ Iterator.prototype._next = function (callback) {
       callback()
     })
   } else {
-    binding.iterator_next(this.context, function (err, array, finished) {
+    binding.iterator_next(this.context, function (err, data, finished, offsets) {
       if (err) return callback(err)
 
-      that.cache = array
+      that.cache = data
+      that.offsets = offsets || null
+      that.position = 0
       that.finished = finished
       that._next(callback)
     })
@@ -53,8 +68,19 @@ Iterator.prototype._next = function (callback) {
   return this
 }
 
+// Returns the next key or value of a packed chunk, without copying it.
+Iterator.prototype._slice = function (asBuffer) {
+  var start = this.offsets[this.position]
+  var end = this.offsets[++this.position]
+
+  return asBuffer
+    ? this.cache.slice(start, end)
+    : this.cache.toString('utf8', start, end)
+}
+
 Iterator.prototype._end = function (callback) {
   delete this.cache
+  delete this.offsets
   binding.iterator_end(this.context, callback)
 }
 
@@ -1,8 +1,11 @@
 const util = require('util')
 const AbstractLevelDOWN = require('abstract-leveldown').AbstractLevelDOWN
 const binding = require('./binding')
+const Cache = require('./cache')
+const WriteBufferManager = require('./write-buffer-manager')
 const ChainedBatch = require('./chained-batch')
 const Iterator = require('./iterator')
+const packBatch = require('./packed-batch')
 
 function LevelDOWN (location) {
   if (!(this instanceof LevelDOWN)) {
@@ -22,6 +25,31 @@ function LevelDOWN (location) {
 util.inherits(LevelDOWN, AbstractLevelDOWN)
 
 LevelDOWN.prototype._open = function (options, callback) {
+  if (options.cache != null && !(options.cache instanceof Cache)) {
+    return process.nextTick(callback, new Error('`cache` must be a leveldown.Cache'))
+  }
+
+  if (!Cache.isPolicy(options.cachePolicy)) {
+    return process.nextTick(callback, new Error('`cachePolicy` must be \'lru\' or \'segmented\''))
+  }
+
+  if (options.memtableBloomSizeRatio != null &&
+      !Number.isFinite(options.memtableBloomSizeRatio)) {
+    return process.nextTick(callback, new Error('`memtableBloomSizeRatio` must be a finite number'))
+  }
+
+  if (options.writeBufferManager != null &&
+      !(options.writeBufferManager instanceof WriteBufferManager)) {
+    return process.nextTick(callback, new Error('`writeBufferManager` must be a leveldown.WriteBufferManager'))
+  }
+
+  // Pass the native contexts of shared objects
+  options = Object.assign({}, options, {
+    cache: options.cache && options.cache.context,
+    writeBufferManager: options.writeBufferManager &&
+      options.writeBufferManager.context
+  })
+
   binding.db_open(this.context, this.location, options, callback)
 }
 
@@ -42,9 +70,54 @@ LevelDOWN.prototype._put = function (key, value, options, callback) {
 }
 
 LevelDOWN.prototype._get = function (key, options, callback) {
+  if (options.inline && this.status === 'open') {
+    var value
+
+    try {
+      value = binding.db_try_get(this.context, key, options)
+    } catch (err) {
+      return process.nextTick(callback, err)
+    }
+
+    if (value === undefined) {
+      return process.nextTick(callback, new Error('NotFound: '))
+    } else if (value !== null) {
+      return process.nextTick(callback, null, value)
+    }
+  }
+
   binding.db_get(this.context, key, options, callback)
 }
 
+LevelDOWN.prototype.getMany = function (keys, options, callback) {
+  if (typeof options === 'function') {
+    callback = options
+    options = {}
+  }
+
+  if (!Array.isArray(keys)) {
+    throw new Error('getMany() requires an array of keys')
+  }
+
+  if (typeof callback !== 'function') {
+    throw new Error('getMany() requires a callback argument')
+  }
+
+  if (this.status !== 'open') {
+    return process.nextTick(callback, new Error('Database is not open'))
+  }
+
+  for (var i = 0; i < keys.length; i++) {
+    var err = this._checkKey(keys[i])
+    if (err) return process.nextTick(callback, err)
+  }
+
+  options = Object.assign({ asBuffer: true, fillCache: true }, options)
+  keys = keys.map(this._serializeKey, this)
+
+  binding.db_get_many(this.context, keys, options, callback)
+}
+
 LevelDOWN.prototype._del = function (key, options, callback) {
   binding.db_del(this.context, key, options, callback)
 }
@@ -57,6 +130,27 @@ LevelDOWN.prototype._batch = function (operations, options, callback) {
   binding.batch_do(this.context, operations, options, callback)
 }
 
+LevelDOWN.prototype.packedBatch = function (buffer, options, callback) {
+  if (typeof options === 'function') {
+    callback = options
+    options = {}
+  }
+
+  if (!Buffer.isBuffer(buffer)) {
+    throw new Error('packedBatch() requires a buffer argument')
+  }
+
+  if (typeof callback !== 'function') {
+    throw new Error('packedBatch() requires a callback argument')
+  }
+
+  if (this.status !== 'open') {
+    return process.nextTick(callback, new Error('Database is not open'))
+  }
+
+  binding.batch_do_packed(this.context, buffer, options || {}, callback)
+}
+
 LevelDOWN.prototype.approximateSize = function (start, end, callback) {
   if (start == null ||
       end == null ||
@@ -101,12 +195,30 @@ LevelDOWN.prototype.getProperty = function (property) {
   return binding.db_get_property(this.context, property)
 }
 
+LevelDOWN.prototype.writeStallState = function () {
+  return binding.db_write_stall_state(this.context)
+}
+
+LevelDOWN.prototype.onWriteStall = function (listener) {
+  if (listener !== null && typeof listener !== 'function') {
+    throw new Error('onWriteStall() requires a function or null')
+  }
+
+  binding.db_set_write_stall_listener(this.context, listener)
+}
+
 LevelDOWN.prototype._iterator = function (options) {
   if (this.status !== 'open') {
     // Prevent segfault
     throw new Error('cannot call iterator() before open()')
   }
 
+  if (options.prefix != null) {
+    options = Object.assign({}, options, {
+      prefix: this._serializeKey(options.prefix)
+    })
+  }
+
   return new Iterator(this, options)
 }
 
@@ -138,4 +250,8 @@ LevelDOWN.repair = function (location, callback) {
   binding.repair_db(location, callback)
 }
 
+LevelDOWN.packBatch = packBatch
+LevelDOWN.Cache = Cache
+LevelDOWN.WriteBufferManager = WriteBufferManager
+
 module.exports = LevelDOWN.default = LevelDOWN
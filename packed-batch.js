@@ -0,0 +1,98 @@
+// Encodes operations in the format of a LevelDB WriteBatch, so that they can
+// be written with db.packedBatch() without any per-operation native calls:
+//
+//   header := sequence (fixed64, filled in by LevelDB) count (fixed32)
+//   record := 0x01 varstring(key) varstring(value) | 0x00 varstring(key)
+//   varstring := length (varint32) data
+
+const HEADER_SIZE = 12
+const TYPE_DEL = 0
+const TYPE_PUT = 1
+
+function varintLength (n) {
+  var length = 1
+  while (n >= 0x80) {
+    n >>>= 7
+    length++
+  }
+  return length
+}
+
+function writeVarint (buffer, offset, n) {
+  while (n >= 0x80) {
+    buffer[offset++] = (n & 0x7f) | 0x80
+    n >>>= 7
+  }
+  buffer[offset++] = n
+  return offset
+}
+
+function byteLength (data) {
+  return Buffer.isBuffer(data) ? data.length : Buffer.byteLength(data)
+}
+
+function writeData (buffer, offset, data, length) {
+  offset = writeVarint(buffer, offset, length)
+  if (Buffer.isBuffer(data)) data.copy(buffer, offset)
+  else buffer.write(data, offset, length)
+  return offset + length
+}
+
+function serialize (data) {
+  return Buffer.isBuffer(data) ? data : String(data)
+}
+
+function packBatch (operations) {
+  if (!Array.isArray(operations)) {
+    throw new Error('packBatch() requires an array of operations')
+  }
+
+  var ops = []
+  var size = HEADER_SIZE
+
+  for (var i = 0; i < operations.length; i++) {
+    var op = operations[i]
+
+    if (typeof op !== 'object' || op === null) continue
+    if (op.type !== 'put' && op.type !== 'del') continue
+    if (op.key == null) throw new Error('key cannot be `null` or `undefined`')
+
+    var key = serialize(op.key)
+    var keyLength = byteLength(key)
+    var record = { type: op.type, key: key, keyLength: keyLength }
+
+    size += 1 + varintLength(keyLength) + keyLength
+
+    if (op.type === 'put') {
+      if (op.value == null) throw new Error('value cannot be `null` or `undefined`')
+
+      record.value = serialize(op.value)
+      record.valueLength = byteLength(record.value)
+      size += varintLength(record.valueLength) + record.valueLength
+    }
+
+    ops.push(record)
+  }
+
+  var buffer = Buffer.alloc(size)
+  var offset = HEADER_SIZE
+
+  buffer.writeUInt32LE(ops.length, 8)
+
+  for (i = 0; i < ops.length; i++) {
+    record = ops[i]
+
+    if (record.type === 'put') {
+      buffer[offset++] = TYPE_PUT
+      offset = writeData(buffer, offset, record.key, record.keyLength)
+      offset = writeData(buffer, offset, record.value, record.valueLength)
+    } else {
+      buffer[offset++] = TYPE_DEL
+      offset = writeData(buffer, offset, record.key, record.keyLength)
+    }
+  }
+
+  return buffer
+}
+
+module.exports = packBatch
@@ -0,0 +1,62 @@
+const test = require('tape')
+const testCommon = require('./common')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open({ dataBlockHashIndex: true }, t.end.bind(t))
+})
+
+test('test get() with block hash index', function (t) {
+  var ops = []
+  for (var i = 0; i < 1000; i++) {
+    ops.push({ type: 'put', key: 'key' + i, value: 'value' + i })
+  }
+
+  db.batch(ops, function (err) {
+    t.ifError(err, 'no batch error')
+
+    db.batch(ops.filter(function (op, i) {
+      return i % 3 === 0
+    }).map(function (op) {
+      return { type: 'put', key: op.key, value: 'new' }
+    }), function (err) {
+      t.ifError(err, 'no batch error')
+
+      db.compactRange('key', 'key~', function (err) {
+        t.ifError(err, 'no compactRange error')
+
+        db.getMany(['key1', 'key3', 'key999', 'key1000'], {
+          asBuffer: false
+        }, function (err, values) {
+          t.ifError(err, 'no getMany error')
+          t.same(values, ['value1', 'new', 'new', undefined])
+          t.end()
+        })
+      })
+    })
+  })
+})
+
+test('test tables are readable without the option', function (t) {
+  db.close(function (err) {
+    t.ifError(err, 'no close error')
+
+    db.open({ dataBlockHashIndex: false }, function (err) {
+      t.ifError(err, 'no open error')
+
+      db.get('key500', { asBuffer: false }, function (err, value) {
+        t.ifError(err, 'no get error')
+        t.is(value, 'value500')
+        t.end()
+      })
+    })
+  })
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
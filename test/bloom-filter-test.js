@@ -0,0 +1,142 @@
+const test = require('tape')
+const testCommon = require('./common')
+
+test('setUp common', testCommon.setUp)
+
+function fill (bloomBitsPerKey, callback, options) {
+  var db = testCommon.factory()
+  var ops = []
+
+  for (var i = 0; i < 1000; i++) {
+    ops.push({ type: 'put', key: 'key' + i, value: 'value' + i })
+  }
+
+  options = Object.assign({ bloomBitsPerKey: bloomBitsPerKey }, options)
+
+  db.open(options, function (err) {
+    if (err) return callback(err)
+    db.batch(ops, function (err) {
+      if (err) return callback(err)
+      db.compactRange('key', 'key~', function (err) {
+        if (err) return callback(err)
+        db.approximateSize('key', 'key~', function (err, size) {
+          callback(err, db, size)
+        })
+      })
+    })
+  })
+}
+
+test('test bloomBitsPerKey changes table size', function (t) {
+  fill(0, function (err, db0, size0) {
+    t.ifError(err, 'no error without filters')
+
+    fill(16, function (err, db16, size16) {
+      t.ifError(err, 'no error with filters')
+      t.ok(size16 > size0, 'filters take up space in tables')
+
+      db0.get('key500', { asBuffer: false }, function (err, value) {
+        t.ifError(err, 'no get error without filters')
+        t.is(value, 'value500')
+
+        db16.get('key500', { asBuffer: false }, function (err, value) {
+          t.ifError(err, 'no get error with filters')
+          t.is(value, 'value500')
+
+          db0.close(function () {
+            db16.close(t.end.bind(t))
+          })
+        })
+      })
+    })
+  })
+})
+
+test('test filters in the block cache', function (t) {
+  fill(10, function (err, db) {
+    t.ifError(err, 'no error')
+
+    db.get('key500', { asBuffer: false }, function (err, value) {
+      t.ifError(err, 'no get error')
+      t.is(value, 'value500')
+
+      db.get('key5000', function (err) {
+        t.ok(err && /NotFound/.test(err.message), 'missing key not found')
+        db.close(t.end.bind(t))
+      })
+    })
+  }, { cacheIndexAndFilterBlocks: true, pinL0IndexAndFilterBlocks: true })
+})
+
+test('test partitioned index and filters', function (t) {
+  fill(10, function (err, db) {
+    t.ifError(err, 'no error')
+
+    db.get('key500', { asBuffer: false }, function (err, value) {
+      t.ifError(err, 'no get error')
+      t.is(value, 'value500')
+
+      db.get('key5000', function (err) {
+        t.ok(err && /NotFound/.test(err.message), 'missing key not found')
+
+        var count = 0
+        var it = db.iterator({ gte: 'key1', lt: 'key2' })
+        it.next(function next (err, key) {
+          t.ifError(err, 'no next error')
+          if (key === undefined) {
+            t.is(count, 111, 'iterated over range')
+            return it.end(function () { db.close(t.end.bind(t)) })
+          }
+          count++
+          it.next(next)
+        })
+      })
+    })
+  }, { partitionIndexAndFilters: true, blockSize: 256 })
+})
+
+test('test blocked bloom filter', function (t) {
+  fill(10, function (err, db) {
+    t.ifError(err, 'no error')
+
+    db.get('key500', { asBuffer: false }, function (err, value) {
+      t.ifError(err, 'no get error')
+      t.is(value, 'value500')
+
+      db.get('key5000', function (err) {
+        t.ok(err && /NotFound/.test(err.message), 'missing key not found')
+
+        db.close(function (err) {
+          t.ifError(err, 'no close error')
+
+          // Tables with the other filters are still readable
+          db.open({ blockedBloomFilter: false }, function (err) {
+            t.ifError(err, 'no open error')
+
+            db.get('key999', { asBuffer: false }, function (err, value) {
+              t.ifError(err, 'no get error')
+              t.is(value, 'value999')
+              db.close(t.end.bind(t))
+            })
+          })
+        })
+      })
+    })
+  }, { blockedBloomFilter: true })
+})
+
+test('test whole table filter', function (t) {
+  fill(10, function (err, db) {
+    t.ifError(err, 'no error')
+
+    db.getMany(['key0', 'key500', 'key999', 'key5000'], {
+      asBuffer: false
+    }, function (err, values) {
+      t.ifError(err, 'no getMany error')
+      t.same(values, ['value0', 'value500', 'value999', undefined])
+      db.close(t.end.bind(t))
+    })
+  }, { wholeTableFilter: true })
+})
+
+test('tearDown', testCommon.tearDown)
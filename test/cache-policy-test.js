@@ -0,0 +1,86 @@
+const test = require('tape')
+const testCommon = require('./common')
+const leveldown = require('..')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('test open() with an unknown cachePolicy', function (t) {
+  var db = testCommon.factory()
+
+  db.open({ cachePolicy: 'mru' }, function (err) {
+    t.is(err && err.message, '`cachePolicy` must be \'lru\' or \'segmented\'')
+    t.end()
+  })
+})
+
+test('test Cache() with an unknown policy throws', function (t) {
+  t.throws(leveldown.Cache.bind(null, 1024, { policy: 'mru' }), {
+    name: 'Error',
+    message: 'Cache() requires a `policy` of \'lru\' or \'segmented\''
+  }, 'unknown policy throws')
+  t.ok(leveldown.Cache(1024, { policy: 'segmented' }), 'segmented cache')
+  t.ok(leveldown.Cache(1024, { shards: 4 }), 'cache with 4 shards')
+  t.end()
+})
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open({ cachePolicy: 'segmented', cacheSize: 64 * 1024 }, t.end.bind(t))
+})
+
+test('test segmented cache keeps reads intact', function (t) {
+  var ops = []
+  for (var i = 0; i < 500; i++) {
+    ops.push({ type: 'put', key: String(i).padStart(4, '0'), value: Buffer.alloc(512, i) })
+  }
+
+  db.batch(ops, function (err) {
+    t.ifError(err, 'no batch error')
+
+    db.compactRange('0000', '9999', function (err) {
+      t.ifError(err, 'no compactRange error')
+
+      var keys = ops.map(function (op) { return op.key })
+      var rounds = 0
+
+      // Read the data repeatedly, so that blocks are protected and demoted
+      ;(function read () {
+        if (rounds++ === 3) return t.end()
+
+        db.getMany(keys, function (err, values) {
+          t.ifError(err, 'no getMany error')
+          t.ok(values.every(function (value, i) {
+            return value.equals(Buffer.alloc(512, i))
+          }), 'every key has its value')
+          read()
+        })
+      })()
+    })
+  })
+})
+
+test('test cacheShards', function (t) {
+  var shards = [1, 3, 1024]
+
+  ;(function next () {
+    if (shards.length === 0) return t.end()
+
+    db.close(function (err) {
+      t.ifError(err, 'no close error')
+      db.open({ cacheShards: shards.shift(), cacheSize: 64 * 1024 }, function (err) {
+        t.ifError(err, 'no open error')
+        db.get('0042', function (err, value) {
+          t.ifError(err, 'no get error')
+          t.same(value, Buffer.alloc(512, 42))
+          next()
+        })
+      })
+    })
+  })()
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
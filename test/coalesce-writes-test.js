@@ -0,0 +1,71 @@
+const test = require('tape')
+const testCommon = require('./common')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open({ coalesceWrites: true }, t.end.bind(t))
+})
+
+test('test concurrent writes are coalesced', function (t) {
+  var pending = 0
+  var order = []
+
+  function done (id) {
+    return function (err) {
+      t.ifError(err, 'no write error')
+      order.push(id)
+      if (--pending === 0) verify()
+    }
+  }
+
+  for (var i = 0; i < 100; i++) {
+    pending++
+    db.put('key' + i, 'value' + i, done(i))
+  }
+
+  pending++
+  db.del('key0', done('del'))
+
+  pending++
+  db.batch([
+    { type: 'put', key: Buffer.from('key1'), value: Buffer.from('batch') },
+    { type: 'del', key: 'key2' }
+  ], done('batch'))
+
+  function verify () {
+    t.is(order.length, 102, 'every callback called once')
+    t.is(order[0], 0, 'callbacks called in write order')
+    t.is(order[101], 'batch', 'callbacks called in write order')
+
+    db.getMany(['key0', 'key1', 'key2', 'key99'], { asBuffer: false }, function (err, values) {
+      t.ifError(err, 'no getMany error')
+      t.same(values, [undefined, 'batch', undefined, 'value99'], 'writes applied in order')
+      t.end()
+    })
+  }
+})
+
+test('test close() waits for coalesced writes', function (t) {
+  var written = 0
+
+  for (var i = 0; i < 10; i++) {
+    db.put('close' + i, 'value', function (err) {
+      t.ifError(err, 'no put error')
+      written++
+    })
+  }
+
+  db.close(function (err) {
+    t.ifError(err, 'no close error')
+    t.is(written, 10, 'writes completed before close')
+    t.end()
+  })
+})
+
+test('tearDown', function (t) {
+  testCommon.tearDown(t)
+})
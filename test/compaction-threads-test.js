@@ -0,0 +1,68 @@
+const test = require('tape')
+const testCommon = require('./common')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open({
+    compactionThreads: 4,
+    subcompactions: 4,
+    writeBufferSize: 64 * 1024
+  }, t.end.bind(t))
+})
+
+test('test concurrent compactions keep data intact', function (t) {
+  var value = Buffer.alloc(1024, 'x')
+  var rounds = 0
+
+  function write () {
+    if (rounds === 8) return compact()
+
+    var ops = []
+    for (var i = 0; i < 1000; i++) {
+      // Overwrite keys of earlier rounds, so that compactions overlap
+      var key = String((i * 7 + rounds * 13) % 4000).padStart(4, '0')
+      ops.push({ type: 'put', key: key, value: value })
+    }
+    rounds++
+
+    db.batch(ops, function (err) {
+      t.ifError(err, 'no batch error')
+      write()
+    })
+  }
+
+  function compact () {
+    db.compactRange('0000', '9999', function (err) {
+      t.ifError(err, 'no compactRange error')
+
+      var it = db.iterator({ keyAsBuffer: false, values: false })
+      var keys = []
+
+      it.next(function next (err, key) {
+        if (err || key === undefined) {
+          t.ifError(err, 'no next error')
+
+          it.end(function (err) {
+            t.ifError(err, 'no end error')
+            t.is(keys.length, 4000, 'every key is present once')
+            t.same(keys, keys.slice().sort(), 'keys are sorted')
+            t.end()
+          })
+          return
+        }
+        keys.push(key)
+        it.next(next)
+      })
+    })
+  }
+
+  write()
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
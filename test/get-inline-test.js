@@ -0,0 +1,99 @@
+const test = require('tape')
+const testCommon = require('./common')
+const binding = require('../binding')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open(t.end.bind(t))
+})
+
+test('test inline get() from memtable', function (t) {
+  db.put('foo', 'bar', function (err) {
+    t.ifError(err, 'no put error')
+
+    var sync = true
+    db.get('foo', { inline: true }, function (err, value) {
+      t.ifError(err, 'no get error')
+      t.is(sync, false, 'callback is asynchronous')
+      t.same(value, Buffer.from('bar'))
+
+      db.get('foo', { inline: true, asBuffer: false }, function (err, value) {
+        t.ifError(err, 'no get error')
+        t.is(value, 'bar')
+        t.end()
+      })
+    })
+    sync = false
+  })
+})
+
+test('test inline get() of missing key', function (t) {
+  db.get('missing', { inline: true }, function (err, value) {
+    t.ok(err, 'got error')
+    t.ok(/NotFound/i.test(err.message), 'is NotFound error')
+    t.is(value, undefined, 'no value')
+    t.end()
+  })
+})
+
+test('test inline get() falls back to reading tables', function (t) {
+  db.compactRange('a', 'z', function (err) {
+    t.ifError(err, 'no compactRange error')
+
+    db.close(function (err) {
+      t.ifError(err, 'no close error')
+
+      db.open(function (err) {
+        t.ifError(err, 'no open error')
+
+        db.get('foo', { inline: true, asBuffer: false }, function (err, value) {
+          t.ifError(err, 'no get error')
+          t.is(value, 'bar')
+          t.end()
+        })
+      })
+    })
+  })
+})
+
+test('test db_try_get() only answers without file I/O', function (t) {
+  var options = { asBuffer: false }
+
+  db.put('fop', 'baz', function (err) {
+    t.ifError(err, 'no put error')
+
+    db.compactRange('a', 'z', function (err) {
+      t.ifError(err, 'no compactRange error')
+
+      db.close(function (err) {
+        t.ifError(err, 'no close error')
+
+        db.open(function (err) {
+          t.ifError(err, 'no open error')
+          t.is(binding.db_try_get(db.context, 'foo', options), null, 'table is not open')
+
+          // Opens the table, whose filter rules out the key
+          db.get('foo0', function (err) {
+            t.ok(err && /NotFound/i.test(err.message), 'is NotFound error')
+            t.is(binding.db_try_get(db.context, 'foo1', options), undefined, 'filtered miss')
+            t.is(binding.db_try_get(db.context, 'foo', options), null, 'block is not cached')
+
+            db.put('mem', 'value', function (err) {
+              t.ifError(err, 'no put error')
+              t.is(binding.db_try_get(db.context, 'mem', options), 'value', 'memtable hit')
+              t.end()
+            })
+          })
+        })
+      })
+    })
+  })
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
@@ -0,0 +1,107 @@
+const test = require('tape')
+const testCommon = require('./common')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open(t.end.bind(t))
+})
+
+test('test argument-less getMany() throws', function (t) {
+  t.throws(db.getMany.bind(db), {
+    name: 'Error',
+    message: 'getMany() requires an array of keys'
+  }, 'no-arg getMany() throws')
+  t.end()
+})
+
+test('test callback-less getMany() throws', function (t) {
+  t.throws(db.getMany.bind(db, ['foo']), {
+    name: 'Error',
+    message: 'getMany() requires a callback argument'
+  }, 'callback-less getMany() throws')
+  t.end()
+})
+
+test('test getMany() with empty array', function (t) {
+  db.getMany([], function (err, values) {
+    t.ifError(err, 'no getMany error')
+    t.same(values, [], 'empty result')
+    t.end()
+  })
+})
+
+test('test getMany() returns values in key order', function (t) {
+  db.batch([
+    { type: 'put', key: 'a', value: 'A' },
+    { type: 'put', key: 'b', value: 'B' },
+    { type: 'put', key: 'c', value: 'C' }
+  ], function (err) {
+    t.ifError(err, 'no batch error')
+
+    db.getMany(['c', Buffer.from('a'), 'missing', 'b'], function (err, values) {
+      t.ifError(err, 'no getMany error')
+      t.is(values.length, 4, 'one value per key')
+      t.ok(Buffer.isBuffer(values[0]), 'values are buffers by default')
+      t.same(values[0], Buffer.from('C'))
+      t.same(values[1], Buffer.from('A'))
+      t.is(values[2], undefined, 'missing key yields undefined')
+      t.same(values[3], Buffer.from('B'))
+      t.end()
+    })
+  })
+})
+
+test('test getMany() with asBuffer: false', function (t) {
+  db.getMany(['a', 'b', 'nope'], { asBuffer: false }, function (err, values) {
+    t.ifError(err, 'no getMany error')
+    t.same(values, ['A', 'B', undefined])
+    t.end()
+  })
+})
+
+test('test getMany() serializes keys', function (t) {
+  t.plan(3)
+
+  var clone = Object.create(db)
+  var count = 0
+
+  clone._serializeKey = function (key) {
+    t.is(key, count++)
+    return db._serializeKey(key)
+  }
+
+  clone.getMany([0, 1], function (err) {
+    t.ifError(err, 'no getMany error')
+  })
+})
+
+test('test getMany() with invalid keys yields first key error', function (t) {
+  t.plan(3)
+
+  db.getMany(['a', null, undefined], function (err) {
+    t.is(err && err.message, 'key cannot be `null` or `undefined`', 'null key')
+  })
+
+  db.getMany([undefined], function (err) {
+    t.is(err && err.message, 'key cannot be `null` or `undefined`', 'undefined key')
+  })
+
+  db.getMany(['a', ''], function (err) {
+    t.is(err && err.message, 'key cannot be an empty String', 'empty key')
+  })
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
+
+test('test getMany() on closed db yields error', function (t) {
+  db.getMany(['a'], function (err) {
+    t.ok(err, 'got error')
+    t.end()
+  })
+})
@@ -0,0 +1,66 @@
+const test = require('tape')
+const testCommon = require('./common')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open({
+    maxImmutableMemtables: 4,
+    writeBufferSize: 64 * 1024
+  }, t.end.bind(t))
+})
+
+test('test queued write buffers keep data intact', function (t) {
+  var expected = {}
+  var rounds = 0
+
+  function write () {
+    if (rounds === 16) return check()
+
+    var ops = []
+    for (var i = 0; i < 100; i++) {
+      var key = String((i * 7 + rounds * 13) % 1000).padStart(4, '0')
+      ops.push({ type: 'put', key: key, value: Buffer.alloc(1024, rounds) })
+      expected[key] = rounds
+    }
+    rounds++
+
+    db.batch(ops, function (err) {
+      t.ifError(err, 'no batch error')
+      write()
+    })
+  }
+
+  function check () {
+    verify(function () {
+      db.close(function (err) {
+        t.ifError(err, 'no close error')
+        db.open(function (err) {
+          t.ifError(err, 'no open error')
+          verify(t.end.bind(t))
+        })
+      })
+    })
+  }
+
+  function verify (callback) {
+    var keys = Object.keys(expected)
+
+    db.getMany(keys, function (err, values) {
+      t.ifError(err, 'no getMany error')
+      t.ok(values.every(function (value, i) {
+        return value.equals(Buffer.alloc(1024, expected[keys[i]]))
+      }), 'every key has its newest value')
+      callback()
+    })
+  }
+
+  write()
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
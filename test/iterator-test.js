@@ -88,3 +88,113 @@ make('close db with open iterator', function (db, t, done) {
     done(null, false)
   })
 })
+
+make('packed iterator yields the same entries', function (db, t, done) {
+  var ops = []
+  for (var i = 0; i < 100; i++) {
+    ops.push({ type: 'put', key: 'k' + (1000 + i), value: 'v' + i })
+  }
+
+  db.batch(ops, function (err) {
+    t.ifError(err, 'no error from batch()')
+
+    var ite = db.iterator({ packed: true, highWaterMark: 64, keyAsBuffer: false })
+    var entries = []
+
+    ite.next(function loop (err, key, value) {
+      t.ifError(err, 'no error from next()')
+
+      if (key === undefined) {
+        t.is(entries.length, 103, 'got all entries')
+        t.same(entries[0], ['k1000', Buffer.from('v0')])
+        t.same(entries[99], ['k1099', Buffer.from('v99')])
+        t.same(entries[100], ['one', Buffer.from('1')])
+        return ite.end(done)
+      }
+
+      t.is(typeof key, 'string', 'key is a string')
+      t.ok(Buffer.isBuffer(value), 'value is a buffer')
+      entries.push([key, value])
+      ite.next(loop)
+    })
+  })
+})
+
+make('packed iterator delivers a chunk as one buffer', function (db, t, done) {
+  var ite = db.iterator({ packed: true, keys: false })
+
+  ite.next(function (err, key, value) {
+    t.ifError(err, 'no error from next()')
+    t.same(key, Buffer.alloc(0), 'key is empty')
+    t.same(value, Buffer.from('1'))
+    ite.next(function (err, key, value) {
+      t.ifError(err, 'no error from next()')
+      t.ok(Buffer.isBuffer(ite.cache), 'cache is a single buffer')
+      t.ok(ite.offsets instanceof Uint32Array, 'offsets are a Uint32Array')
+      t.is(ite.offsets.length, 5, 'offsets of two rows')
+      t.is(value.buffer, ite.cache.buffer, 'value is a view of the cache')
+      ite.seek('one')
+      t.notOk(ite.offsets, 'offsets are removed')
+      ite.next(function (err, key, value) {
+        t.ifError(err, 'no error from next()')
+        t.same(value, Buffer.from('1'))
+        ite.end(done)
+      })
+    })
+  })
+})
+
+make('iterator with prefetch yields all entries in order', function (db, t, done) {
+  var ops = []
+  for (var i = 0; i < 1000; i++) {
+    ops.push({ type: 'put', key: 'k' + (1000 + i), value: 'v' + i })
+  }
+
+  db.batch(ops, function (err) {
+    t.ifError(err, 'no error from batch()')
+
+    var ite = db.iterator({ prefetch: 2, highWaterMark: 100, keyAsBuffer: false })
+    var keys = []
+
+    ite.next(function loop (err, key) {
+      t.ifError(err, 'no error from next()')
+      if (key === undefined) {
+        t.is(keys.length, 1003, 'got all entries')
+        t.same(keys, keys.slice().sort(), 'in order')
+        return ite.end(done)
+      }
+      keys.push(key)
+      ite.next(loop)
+    })
+  })
+})
+
+make('iterator with prefetch can seek while reading ahead', function (db, t, done) {
+  var ite = db.iterator({ prefetch: 1, keyAsBuffer: false })
+
+  ite.next(function (err, key) {
+    t.ifError(err, 'no error from next()')
+    t.is(key, 'one', 'key matches')
+    ite.seek('three')
+    ite.next(function (err, key) {
+      t.ifError(err, 'no error from next()')
+      t.is(key, 'three', 'key matches after seek')
+      ite.seek('two')
+      ite.seek('one')
+      ite.next(function (err, key) {
+        t.ifError(err, 'no error from next()')
+        t.is(key, 'one', 'key matches after second seek')
+        ite.end(done)
+      })
+    })
+  })
+})
+
+make('iterator with prefetch can end while reading ahead', function (db, t, done) {
+  var ite = db.iterator({ prefetch: 4 })
+
+  ite.next(function (err, key) {
+    t.ifError(err, 'no error from next()')
+    ite.end(done)
+  })
+})
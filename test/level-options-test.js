@@ -0,0 +1,60 @@
+const test = require('tape')
+const testCommon = require('./common')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open({
+    writeBufferSize: 64 * 1024,
+    l0CompactionTrigger: 100,
+    maxMemCompactLevel: 0,
+    levelSizeMultiplier: 4,
+    dynamicLevelSizes: true
+  }, t.end.bind(t))
+})
+
+test('test level-0 files are kept up to l0CompactionTrigger', function (t) {
+  var value = Buffer.alloc(1024, 'x')
+  var rounds = 0
+
+  function write () {
+    if (rounds === 8) return check()
+
+    var ops = []
+    for (var i = 0; i < 100; i++) {
+      // Every round overwrites the same keys, so that the files overlap
+      ops.push({ type: 'put', key: String(i).padStart(3, '0'), value: value })
+    }
+    rounds++
+
+    db.batch(ops, function (err) {
+      t.ifError(err, 'no batch error')
+      write()
+    })
+  }
+
+  function check () {
+    var files = Number(db.getProperty('leveldb.num-files-at-level0'))
+    t.ok(files >= 4, 'level-0 has ' + files + ' files')
+
+    db.compactRange('000', '999', function (err) {
+      t.ifError(err, 'no compactRange error')
+      t.is(db.getProperty('leveldb.num-files-at-level0'), '0', 'level-0 is empty')
+
+      db.get('042', function (err, v) {
+        t.ifError(err, 'no get error')
+        t.same(v, value, 'value is intact')
+        t.end()
+      })
+    })
+  }
+
+  write()
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
@@ -0,0 +1,54 @@
+const test = require('tape')
+const testCommon = require('./common')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('test open() with a non-finite memtableBloomSizeRatio', function (t) {
+  var db = testCommon.factory()
+  db.open({ memtableBloomSizeRatio: NaN }, function (err) {
+    t.is(err && err.message, '`memtableBloomSizeRatio` must be a finite number')
+    t.end()
+  })
+})
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open({ memtableBloomSizeRatio: 0.1 }, t.end.bind(t))
+})
+
+test('test get() with memtable bloom filter', function (t) {
+  var ops = []
+  for (var i = 0; i < 1000; i++) {
+    ops.push({ type: 'put', key: 'key' + i, value: 'value' + i })
+  }
+
+  db.batch(ops, function (err) {
+    t.ifError(err, 'no batch error')
+
+    db.compactRange('key', 'key~', function (err) {
+      t.ifError(err, 'no compactRange error')
+
+      db.batch([
+        { type: 'put', key: 'key1', value: 'new' },
+        { type: 'del', key: 'key2' },
+        { type: 'put', key: 'key1000', value: 'value1000' }
+      ], function (err) {
+        t.ifError(err, 'no batch error')
+
+        db.getMany(['key0', 'key1', 'key2', 'key999', 'key1000', 'key1001'], {
+          asBuffer: false
+        }, function (err, values) {
+          t.ifError(err, 'no getMany error')
+          t.same(values, ['value0', 'new', undefined, 'value999', 'value1000', undefined])
+          t.end()
+        })
+      })
+    })
+  })
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
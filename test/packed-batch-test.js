@@ -0,0 +1,111 @@
+const test = require('tape')
+const testCommon = require('./common')
+const leveldown = require('..')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open(t.end.bind(t))
+})
+
+test('test packBatch() requires an array', function (t) {
+  t.throws(leveldown.packBatch.bind(null, 'foo'), {
+    name: 'Error',
+    message: 'packBatch() requires an array of operations'
+  }, 'non-array packBatch() throws')
+  t.end()
+})
+
+test('test packBatch() encodes the WriteBatch format', function (t) {
+  const buffer = leveldown.packBatch([
+    { type: 'put', key: 'k', value: Buffer.from('vv') },
+    { type: 'del', key: Buffer.from('d') },
+    { type: 'noop', key: 'ignored' }
+  ])
+
+  t.same(buffer, Buffer.from([
+    0, 0, 0, 0, 0, 0, 0, 0, // sequence
+    2, 0, 0, 0, // count
+    1, 1, 0x6b, 2, 0x76, 0x76, // put 'k' 'vv'
+    0, 1, 0x64 // del 'd'
+  ]))
+  t.end()
+})
+
+test('test packBatch() encodes multi-byte lengths', function (t) {
+  const value = 'é'.repeat(100)
+  const buffer = leveldown.packBatch([{ type: 'put', key: 'k', value: value }])
+
+  t.is(buffer.length, 12 + 1 + 2 + 2 + 200, 'varint of 200 takes 2 bytes')
+  t.same(buffer.slice(15, 17), Buffer.from([200, 1]))
+  t.is(buffer.slice(17).toString(), value)
+  t.end()
+})
+
+test('test argument-less packedBatch() throws', function (t) {
+  t.throws(db.packedBatch.bind(db), {
+    name: 'Error',
+    message: 'packedBatch() requires a buffer argument'
+  }, 'no-arg packedBatch() throws')
+  t.end()
+})
+
+test('test callback-less packedBatch() throws', function (t) {
+  t.throws(db.packedBatch.bind(db, leveldown.packBatch([])), {
+    name: 'Error',
+    message: 'packedBatch() requires a callback argument'
+  }, 'callback-less packedBatch() throws')
+  t.end()
+})
+
+test('test packedBatch() writes operations', function (t) {
+  db.put('gone', 'soon', function (err) {
+    t.ifError(err, 'no put error')
+
+    const buffer = leveldown.packBatch([
+      { type: 'put', key: 'foo', value: 'bar' },
+      { type: 'put', key: Buffer.from('baz'), value: Buffer.from('qux') },
+      { type: 'del', key: 'gone' }
+    ])
+
+    db.packedBatch(buffer, function (err) {
+      t.ifError(err, 'no packedBatch error')
+
+      db.getMany(['foo', 'baz', 'gone'], { asBuffer: false }, function (err, values) {
+        t.ifError(err, 'no getMany error')
+        t.same(values, ['bar', 'qux', undefined])
+        t.end()
+      })
+    })
+  })
+})
+
+test('test packedBatch() with empty batch', function (t) {
+  db.packedBatch(leveldown.packBatch([]), { sync: true }, function (err) {
+    t.ifError(err, 'no packedBatch error')
+    t.end()
+  })
+})
+
+test('test packedBatch() rejects a malformed batch', function (t) {
+  const buffer = leveldown.packBatch([{ type: 'put', key: 'a', value: 'b' }])
+
+  buffer.writeUInt32LE(2, 8)
+  db.packedBatch(buffer, function (err) {
+    t.ok(err, 'got error for wrong count')
+
+    db.packedBatch(buffer.slice(0, buffer.length - 1), function (err) {
+      t.ok(err, 'got error for truncated record')
+      t.throws(db.packedBatch.bind(db, Buffer.alloc(4), function () {}),
+        /packed batch is too small/, 'short buffer throws')
+      t.end()
+    })
+  })
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
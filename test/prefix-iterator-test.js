@@ -0,0 +1,68 @@
+const test = require('tape')
+const concat = require('level-concat-iterator')
+const testCommon = require('./common')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open({ prefixDelimiter: '!' }, t.end.bind(t))
+})
+
+test('test iterator() with prefix', function (t) {
+  var ops = ['a!1', 'a!2', 'b', 'b!1', 'b!2', 'b!3', 'bb', 'c!1'].map(function (key) {
+    return { type: 'put', key: key, value: key }
+  })
+
+  db.batch(ops, function (err) {
+    t.ifError(err, 'no batch error')
+
+    db.compactRange('a', 'd', function (err) {
+      t.ifError(err, 'no compactRange error')
+
+      db.put('b!0', 'b!0', function (err) {
+        t.ifError(err, 'no put error')
+
+        concat(db.iterator({ prefix: 'b!', keyAsBuffer: false, values: false }), function (err, entries) {
+          t.ifError(err, 'no concat error')
+          t.same(entries.map(function (e) { return e.key }), ['b!0', 'b!1', 'b!2', 'b!3'])
+
+          concat(db.iterator({ prefix: 'b!', reverse: true, gt: 'b!1', keyAsBuffer: false, values: false }), function (err, entries) {
+            t.ifError(err, 'no concat error')
+            t.same(entries.map(function (e) { return e.key }), ['b!3', 'b!2'])
+            t.end()
+          })
+        })
+      })
+    })
+  })
+})
+
+test('test iterator() with missing prefix', function (t) {
+  concat(db.iterator({ prefix: Buffer.from('z!') }), function (err, entries) {
+    t.ifError(err, 'no concat error')
+    t.same(entries, [])
+    t.end()
+  })
+})
+
+test('test seek() with prefix', function (t) {
+  var it = db.iterator({ prefix: 'a!', keyAsBuffer: false, valueAsBuffer: false })
+  it.seek('0')
+  it.next(function (err, key, value) {
+    t.ifError(err, 'no next error')
+    t.is(key, 'a!1')
+    it.seek('a!3')
+    it.next(function (err, key, value) {
+      t.ifError(err, 'no next error')
+      t.is(key, undefined, 'ends at the prefix')
+      it.end(t.end.bind(t))
+    })
+  })
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
@@ -0,0 +1,115 @@
+const test = require('tape')
+const testCommon = require('./common')
+const leveldown = require('..')
+
+const cache = leveldown.Cache(1024 * 1024)
+const manager = leveldown.WriteBufferManager(256 * 1024)
+
+let db1
+let db2
+
+test('setUp common', testCommon.setUp)
+
+test('test Cache() and WriteBufferManager() require a size', function (t) {
+  t.throws(leveldown.Cache.bind(null), {
+    name: 'Error',
+    message: 'Cache() requires a size in bytes'
+  }, 'size-less Cache() throws')
+  t.throws(leveldown.WriteBufferManager.bind(null, 'big'), {
+    name: 'Error',
+    message: 'WriteBufferManager() requires a size in bytes'
+  }, 'WriteBufferManager() with a string throws')
+  t.end()
+})
+
+test('test open() with an invalid cache or write buffer manager', function (t) {
+  var db = testCommon.factory()
+
+  db.open({ cache: 1024 }, function (err) {
+    t.is(err && err.message, '`cache` must be a leveldown.Cache')
+
+    db.open({ writeBufferManager: {} }, function (err) {
+      t.is(err && err.message, '`writeBufferManager` must be a leveldown.WriteBufferManager')
+      t.end()
+    })
+  })
+})
+
+test('setUp dbs', function (t) {
+  var options = {
+    cache: cache,
+    writeBufferManager: manager,
+    writeBufferSize: 64 * 1024 * 1024
+  }
+
+  db1 = testCommon.factory()
+  db2 = testCommon.factory()
+  db1.open(options, function (err) {
+    t.ifError(err, 'no open error')
+    db2.open(options, t.end.bind(t))
+  })
+})
+
+function ops (count, fill) {
+  var result = []
+  for (var i = 0; i < count; i++) {
+    var key = String(i).padStart(4, '0')
+    result.push({ type: 'put', key: key, value: Buffer.alloc(1024, fill) })
+  }
+  return result
+}
+
+test('test writes to one db flush the largest write buffer', function (t) {
+  db1.batch(ops(200, 1), function (err) {
+    t.ifError(err, 'no batch error')
+    t.ok(manager.usage() > 200 * 1024, 'write buffer counts towards budget')
+
+    db2.batch(ops(100, 2), function (err) {
+      t.ifError(err, 'no batch error')
+      t.ok(manager.usage() > 256 * 1024, 'budget is used up')
+
+      // The budget is checked before each write, and db1 switches its
+      // write buffer at its next write
+      db2.put('trigger', 'flush', function (err) {
+        t.ifError(err, 'no put error')
+        db1.put('next', 'write', function (err) {
+          t.ifError(err, 'no put error')
+          wait(100)
+        })
+      })
+
+      // The flush of db1 runs in the background
+      function wait (attempts) {
+        if (manager.usage() < 200 * 1024 || attempts === 0) {
+          t.ok(manager.usage() < 200 * 1024, 'budget is freed')
+          return t.end()
+        }
+        setTimeout(wait, 20, attempts - 1)
+      }
+    })
+  })
+})
+
+test('test dbs read through a shared block cache', function (t) {
+  var keys = ops(200, 0).map(function (op) { return op.key })
+
+  db1.getMany(keys, function (err, values) {
+    t.ifError(err, 'no getMany error')
+    t.ok(values.every(function (value) {
+      return value.equals(Buffer.alloc(1024, 1))
+    }), 'every key has its value')
+    t.ok(cache.usage() <= 1024 * 1024, 'cache stays within its size')
+    t.end()
+  })
+})
+
+test('tearDown', function (t) {
+  db1.close(function (err) {
+    t.ifError(err, 'no close error')
+    db2.close(function (err) {
+      t.ifError(err, 'no close error')
+      t.is(manager.usage(), 0, 'closed dbs release their budget')
+      testCommon.tearDown(t)
+    })
+  })
+})
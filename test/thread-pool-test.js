@@ -0,0 +1,133 @@
+const test = require('tape')
+const fs = require('fs')
+const testCommon = require('./common')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('setUp db with own threads', function (t) {
+  db = testCommon.factory()
+  db.open({ readThreads: 2, writeThreads: 1 }, t.end.bind(t))
+})
+
+test('test reads and writes on own threads', function (t) {
+  var pending = 100
+
+  for (var i = 0; i < 100; i++) {
+    db.put('key' + i, 'value' + i, function (err) {
+      t.ifError(err, 'no put error')
+      if (--pending === 0) read()
+    })
+  }
+
+  function read () {
+    db.get('key42', { asBuffer: false }, function (err, value) {
+      t.ifError(err, 'no get error')
+      t.is(value, 'value42')
+
+      db.getMany(['key1', 'key99'], { asBuffer: false }, function (err, values) {
+        t.ifError(err, 'no getMany error')
+        t.same(values, ['value1', 'value99'])
+        iterate()
+      })
+    })
+  }
+
+  function iterate () {
+    var it = db.iterator({ prefetch: 1 })
+    var count = 0
+
+    it.next(function loop (err, key) {
+      t.ifError(err, 'no next error')
+      if (key === undefined) {
+        t.is(count, 100, 'iterated all entries')
+        return it.end(t.end.bind(t))
+      }
+      count++
+      it.next(loop)
+    })
+  }
+})
+
+test('test compactRange() and batch on own threads', function (t) {
+  db.batch([{ type: 'del', key: 'key1' }], function (err) {
+    t.ifError(err, 'no batch error')
+
+    db.compactRange('key0', 'key99', function (err) {
+      t.ifError(err, 'no compactRange error')
+
+      db.get('key1', function (err) {
+        t.ok(err && /NotFound/.test(err.message), 'key was deleted')
+        t.end()
+      })
+    })
+  })
+})
+
+test('test close with open iterator and reopen', function (t) {
+  var it = db.iterator()
+
+  it.next(function (err) {
+    t.ifError(err, 'no next error')
+  })
+
+  db.close(function (err) {
+    t.ifError(err, 'no close error')
+
+    db.open({ writeThreads: 2 }, function (err) {
+      t.ifError(err, 'no open error')
+
+      db.get('key2', { asBuffer: false }, function (err, value) {
+        t.ifError(err, 'no get error')
+        t.is(value, 'value2', 'reads go to the libuv threadpool')
+        t.end()
+      })
+    })
+  })
+})
+
+test('test reopen with own threads in close callback', function (t) {
+  // Counts the threads of the process, where the platform tells
+  function threadCount () {
+    try {
+      return fs.readdirSync('/proc/self/task').length
+    } catch (err) {
+      return -1
+    }
+  }
+
+  db.close(function (err) {
+    t.ifError(err, 'no close error')
+
+    db.open({ readThreads: 8 }, function (err) {
+      t.ifError(err, 'no open error')
+      var before = threadCount()
+
+      db.close(function (err) {
+        t.ifError(err, 'no close error')
+        var closed = threadCount()
+
+        db.open({ readThreads: 8 }, function (err) {
+          t.ifError(err, 'no open error')
+          var after = threadCount()
+
+          if (before !== -1) {
+            t.is(before - closed, 8, 'close stops the threads')
+            t.is(after, before, 'new threads survive the close')
+          }
+
+          db.get('key2', { asBuffer: false }, function (err, value) {
+            t.ifError(err, 'no get error')
+            t.is(value, 'value2')
+            t.end()
+          })
+        })
+      })
+    })
+  })
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
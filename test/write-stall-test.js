@@ -0,0 +1,79 @@
+const test = require('tape')
+const testCommon = require('./common')
+
+let db
+
+test('setUp common', testCommon.setUp)
+
+test('setUp db', function (t) {
+  db = testCommon.factory()
+  db.open({
+    writeBufferSize: 64 * 1024,
+    maxMemCompactLevel: 0,
+    l0CompactionTrigger: 1,
+    l0SlowdownWritesTrigger: 1,
+    l0StopWritesTrigger: 1
+  }, t.end.bind(t))
+})
+
+test('test argument-less onWriteStall() throws', function (t) {
+  t.throws(db.onWriteStall.bind(db), {
+    name: 'Error',
+    message: 'onWriteStall() requires a function or null'
+  }, 'no-arg onWriteStall() throws')
+  t.end()
+})
+
+test('test writeStallState() of idle db', function (t) {
+  t.same(db.writeStallState(), { condition: 'normal', cause: null })
+  t.end()
+})
+
+test('test onWriteStall() reports stalls', function (t) {
+  var states = []
+  var value = Buffer.alloc(1024, 'x')
+  var rounds = 0
+
+  db.onWriteStall(function (state) {
+    states.push(state)
+  })
+
+  function write () {
+    if (rounds === 64) return setTimeout(check, 100)
+
+    var ops = []
+    for (var i = 0; i < 100; i++) {
+      ops.push({ type: 'put', key: String(i).padStart(3, '0'), value: value })
+    }
+    rounds++
+
+    db.batch(ops, function (err) {
+      t.ifError(err, 'no batch error')
+      write()
+    })
+  }
+
+  function check () {
+    db.onWriteStall(null)
+
+    var conditions = ['normal', 'delayed', 'stopped']
+    var causes = [null, 'level0Files', 'memtables']
+
+    t.ok(states.length > 0, 'got ' + states.length + ' state changes')
+    t.ok(states.every(function (state) {
+      return conditions.indexOf(state.condition) !== -1 &&
+        causes.indexOf(state.cause) !== -1 &&
+        (state.condition === 'normal') === (state.cause === null)
+    }), 'states are valid')
+    t.ok(states.some(function (state) {
+      return state.condition !== 'normal'
+    }), 'writes were held up')
+    t.end()
+  }
+
+  write()
+})
+
+test('tearDown', function (t) {
+  db.close(testCommon.tearDown.bind(null, t))
+})
@@ -0,0 +1,21 @@
+const binding = require('./binding')
+
+// A memory budget for the write buffers of the databases that share it with
+// the `writeBufferManager` option.
+function WriteBufferManager (size) {
+  if (!(this instanceof WriteBufferManager)) {
+    return new WriteBufferManager(size)
+  }
+
+  if (typeof size !== 'number' || size < 0) {
+    throw new Error('WriteBufferManager() requires a size in bytes')
+  }
+
+  this.context = binding.write_buffer_manager_init(size)
+}
+
+WriteBufferManager.prototype.usage = function () {
+  return binding.write_buffer_manager_usage(this.context)
+}
+
+module.exports = WriteBufferManager